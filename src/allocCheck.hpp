@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cassert>
+
+// Debug check that an audio path doesn't allocate. Build with FLAGS += -DQUESTIONABLE_ALLOC_CHECK,
+// plugin.cpp then counts every operator new per thread and a NoAllocScope asserts nothing was allocated
+// while it was alive. Compiles to nothing otherwise.
+#ifdef QUESTIONABLE_ALLOC_CHECK
+namespace alloccheck {
+	extern thread_local size_t allocations;
+}
+
+struct NoAllocScope {
+	size_t start = alloccheck::allocations;
+	~NoAllocScope() {
+		assert(alloccheck::allocations == start && "allocated on the audio thread");
+	}
+};
+#else
+struct NoAllocScope {
+	NoAllocScope() {}
+};
+#endif
@@ -72,6 +72,7 @@ struct Discombobulator : QuestionableModule {
 
 	Discombobulator() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		supportsRandomSeed = true;
 		configParam(FADE_PARAM, 0.f, 1.f, 0.f, "Fade Amount");
 		configInput(VOLTAGE_IN_1, "1");
 		configInput(VOLTAGE_IN_2, "2");
@@ -97,56 +98,71 @@ struct Discombobulator : QuestionableModule {
 		for (int i = 0; i < MAX_INPUTS; i++) {
 			outputSwaps[i] = i;
 		}
-		
+
+		for (int i = 0; i < MAX_INPUTS; i++) {
+			idleOutputs.push_back(VOLTAGE_OUT_1 + i);
+			idleInputs.push_back(VOLTAGE_IN_1 + i);
+		}
 	}
 
 	void process(const ProcessArgs& args) override {
+		applyPendingSeed();
+		updateIdle(args);
 
-		std::vector<int> usableInputs;
+		int usableInputs[MAX_INPUTS];
+		int usableCount = 0;
 		float fadeAmnt = params[FADE_PARAM].getValue() + inputs[FADE_INPUT].getVoltage();
 
 		bool shouldRandomize = gateTrigger.process(inputs[8].getVoltage(), 0.1f, 2.f);
 
 		for (int i = 0; i < MAX_INPUTS; i++) {
 			if (inputs[i].isConnected()) {
-				usableInputs.push_back(i);
+				usableInputs[usableCount++] = i;
 			}
 		}
 
-		if (!usableInputs.size()) return;
+		if (!usableCount) return;
 
 		// swap usable inputs
 		if (shouldRandomize) {
-			std::vector<int> usableInputPool(usableInputs);
-			//std::random_shuffle(usableInputPool, usableInputPool.size());
-			for (int i = usableInputs.size() -1; i >= 0; i--) {
-				int randomInput = randomInt<int>(0, usableInputPool.size()-1);
+			int usableInputPool[MAX_INPUTS];
+			int poolSize = usableCount;
+			std::copy(usableInputs, usableInputs + usableCount, usableInputPool);
+			for (int i = usableCount -1; i >= 0; i--) {
+				int randomInput = randomInt<int>(rng, 0, poolSize-1);
 				fadingInputs[usableInputs[i]][outputSwaps[usableInputs[i]]] = 1.f; // set full fade before swapping
 				outputSwaps[usableInputs[i]] = usableInputPool[randomInput];
-				usableInputPool.erase(usableInputPool.begin()+randomInput);
+				usableInputPool[randomInput] = usableInputPool[--poolSize]; // swap remove, order doesn't matter to a random pick
 			}
 		}
 		
-		PolyphonicValue cumulatedFading[MAX_INPUTS];
+		// fades keep going while idle so waking up picks up where it would have been
 		for (int i = 0; i < MAX_INPUTS; i++) {
 			for (int x = 0; x < MAX_INPUTS; x++) {
-				PolyphonicValue input(inputs[x]);
-				if (x != i) { // skip own audio
-					fadingInputs[i][x] = std::max(0.f, fadingInputs[i][x] - (fadingInputs[i][x] * args.sampleTime));
+				if (x != i) fadingInputs[i][x] = std::max(0.f, fadingInputs[i][x] - (fadingInputs[i][x] * args.sampleTime));
+			}
+		}
+
+		if (!idle) {
+			PolyphonicValue cumulatedFading[MAX_INPUTS];
+			for (int i = 0; i < MAX_INPUTS; i++) {
+				for (int x = 0; x < MAX_INPUTS; x++) {
+					if (x == i) continue; // skip own audio
+					PolyphonicValue input(inputs[x]);
 					input *= fadingInputs[i][x];
 					cumulatedFading[i] += input;
 				}
+				cumulatedFading[i] *= fadeAmnt;
 			}
-			cumulatedFading[i] *= fadeAmnt;
-		}
 
-		for (int i = 0; i < MAX_INPUTS; i++) {
+			for (int i = 0; i < MAX_INPUTS; i++) {
 
-			PolyphonicValue input(inputs[outputSwaps[i]]);
-			
-			input += cumulatedFading[i];
-			input.setOutput(outputs[i]);
+				PolyphonicValue input(inputs[outputSwaps[i]]);
+				
+				input += cumulatedFading[i];
+				input.setOutput(outputs[i]);
 
+			}
 		}
 
 		if (shouldRandomize) lights[BLINK_LIGHT].setBrightness(1.f);
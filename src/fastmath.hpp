@@ -0,0 +1,32 @@
+#pragma once
+
+#include "plugin.hpp"
+#include <cmath>
+
+// Cheap approximations for the audio thread. Templated so the same code runs on
+// float and simd::float_4, errors are measured against libm over the whole input range.
+namespace fastmath {
+
+// sin(2*pi*phase) for any phase, max error ~4e-6
+template <typename T>
+inline T sin2pi(T phase) {
+	using namespace simd;
+	// fold into a quarter period around zero where the series converges fast
+	T x = phase - round(phase);
+	x = ifelse(x > 0.25f, 0.5f - x, x);
+	x = ifelse(x < -0.25f, -0.5f - x, x);
+	T t = x * (float)(2.0 * M_PI);
+	T t2 = t * t;
+	return t * (1.f + t2 * (-1.f/6.f + t2 * (1.f/120.f + t2 * (-1.f/5040.f + t2 * (1.f/362880.f)))));
+}
+
+// asin(x) for x in [-1, 1], Abramowitz and Stegun 4.4.45, max error ~7e-5
+template <typename T>
+inline T asin(T x) {
+	using namespace simd;
+	T a = fmin(fabs(x), 1.f);
+	T r = (float)(M_PI / 2.0) - sqrt(1.f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f + a * -0.0187293f)));
+	return ifelse(x < 0.f, -r, r);
+}
+
+}
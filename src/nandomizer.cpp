@@ -66,6 +66,7 @@ struct Nandomizer : QuestionableModule {
 
 	Nandomizer() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		supportsRandomSeed = true;
 		configParam(FADE_PARAM, 0.f, 1.f, 0.f, "Fade Amount");
 		configInput(VOLTAGE_IN_1, "1");
 		configInput(VOLTAGE_IN_2, "2");
@@ -78,7 +79,9 @@ struct Nandomizer : QuestionableModule {
 		configInput(FADE_INPUT, "Fade");
 		configOutput(SINE_OUTPUT, "");
 		configInput(TRIGGER, "Gate");
-		
+
+		idleOutputs = {SINE_OUTPUT};
+		for (int i = 0; i < MAX_INPUTS; i++) idleInputs.push_back(VOLTAGE_IN_1 + i);
 	}
 
 	float rmsValue(float arr[], int n) {
@@ -101,41 +104,48 @@ struct Nandomizer : QuestionableModule {
 	}
 
 	void process(const ProcessArgs& args) override {
+		applyPendingSeed();
+		updateIdle(args);
 
-		std::vector<int> usableInputs;
+		int usableInputs[MAX_INPUTS];
+		int usableCount = 0;
 		float fadeAmnt = params[FADE_PARAM].getValue() + inputs[FADE_INPUT].getVoltage();
 
 		bool shouldRandomize = gateTrigger.process(inputs[8].getVoltage(), 0.1f, 2.f);
 
 		for (int i = 0; i < MAX_INPUTS; i++) {
 			if (inputs[i].isConnected()) {
-				usableInputs.push_back(i);
+				usableInputs[usableCount++] = i;
 				lights[i].setBrightness(activeOutput == i ? 1.f : 0.25f);
 			} else {
 				lights[i].setBrightness(0.f);
 			}
 		}
 
-		if (!usableInputs.size()) return;
+		if (!usableCount) return;
 
-		if (shouldRandomize) activeOutput = usableInputs[randomInt<int>(0, usableInputs.size()-1)];
+		if (shouldRandomize) activeOutput = usableInputs[randomInt<int>(rng, 0, usableCount-1)];
 
-		PolyphonicValue fadingInputs;
+		// selection and fades keep going while idle so waking up picks up where it would have been
 		for (int i = 0; i < MAX_INPUTS; i++) {
-			PolyphonicValue input(inputs[i]);
-			if (i != activeOutput) {
-				inputFades[i] = std::max(0.f, inputFades[i] - ((inputFades[i] * args.sampleTime)));
+			if (i != activeOutput) inputFades[i] = std::max(0.f, inputFades[i] - ((inputFades[i] * args.sampleTime)));
+			else inputFades[i] = 1.f;
+		}
+
+		if (!idle) {
+			PolyphonicValue fadingInputs;
+			for (int i = 0; i < MAX_INPUTS; i++) {
+				if (i == activeOutput) continue;
+				PolyphonicValue input(inputs[i]);
 				input *= inputFades[i];
 				fadingInputs += input;
-			} else {
-				inputFades[i] = 1.f;
 			}
-		}
-		fadingInputs *= fadeAmnt;
+			fadingInputs *= fadeAmnt;
 
-		PolyphonicValue input(inputs[activeOutput]);
-		input += fadingInputs;
-		input.setOutput(outputs[0]);
+			PolyphonicValue input(inputs[activeOutput]);
+			input += fadingInputs;
+			input.setOutput(outputs[0]);
+		}
 
 		if (shouldRandomize) lights[BLINK_LIGHT].setBrightness(1.f);
 
@@ -1,7 +1,26 @@
 #include "plugin.hpp"
+#include "allocCheck.hpp"
 
 Plugin* pluginInstance;
 
+#ifdef QUESTIONABLE_ALLOC_CHECK
+#include <new>
+#include <cstdlib>
+
+thread_local size_t alloccheck::allocations = 0;
+
+void* operator new(size_t size) {
+	alloccheck::allocations++;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+#endif
+
 const std::function<json_t*(json_t*)>* migrations = {};
 
 UserSettings userSettings("questionablemodules.json", [](json_t* json) {
@@ -9,7 +28,9 @@ UserSettings userSettings("questionablemodules.json", [](json_t* json) {
 
 	UserSettings::json_create_if_not_exists(json, "theme", json_string(""));
 	UserSettings::json_create_if_not_exists(json, "treequencerScreenColor", json_integer(0));
+	UserSettings::json_create_if_not_exists(json, "treequencerHistoryLimit", json_integer(100000)); // roughly nodes held by undo history
 	UserSettings::json_create_if_not_exists(json, "showDescriptors", json_boolean(true));
+	UserSettings::json_create_if_not_exists(json, "qualityBudget", json_integer(25)); // percent of the audio thread for governed modules
 	UserSettings::json_create_if_not_exists(json, "gitPersonalAccessToken", json_string(""));
 	UserSettings::json_create_if_not_exists(json, "nightbinSelectedPlugins", json_array());
 	UserSettings::json_create_if_not_exists(json, "greenscreenCustomColors", json_array());
@@ -31,4 +52,9 @@ void init(Plugin* p) {
 
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
+}
+
+// Rack calls this before unloading the plugin
+extern "C" void destroy() {
+	userSettings.flush();
 }
\ No newline at end of file
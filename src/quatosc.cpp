@@ -2,6 +2,8 @@
 #include "imagepanel.cpp"
 #include "colorBG.hpp"
 #include "questionableModule.hpp"
+#include "fastmath.hpp"
+#include "allocCheck.hpp"
 
 #pragma GCC diagnostic push 
 #pragma GCC diagnostic ignored "-Wdeprecated-copy"
@@ -12,8 +14,7 @@
 
 #include <vector>
 #include <cmath>
-#include <queue>
-#include <mutex>
+#include <atomic>
 #include <algorithm>
 
 /*
@@ -89,18 +90,23 @@ struct QuatOSC : QuestionableModule {
 		SIDES
 	};
 
-	std::atomic<bool> reading = false;
+	enum Projection {
+		PROJECT_X,
+		PROJECT_Y,
+		PROJECT_Z,
+		PROJECTIONS_LEN
+	};
 
-	std::unordered_map<std::string, gmtl::Vec3f> projectionPlanes = {
-		{"X", gmtl::Vec3f{0.f, 1.f, 1.f}},
-		{"Y", gmtl::Vec3f{1.f, 0.f, 1.f}},
-		{"Z", gmtl::Vec3f{1.f, 1.f, 0.f}}
+	// indexed by Projection, so the audio thread never has to look a plane up by name
+	const std::string projectionNames[PROJECTIONS_LEN] = {"X", "Y", "Z"};
+	const gmtl::Vec3f projectionPlanes[PROJECTIONS_LEN] = {
+		gmtl::Vec3f{0.f, 1.f, 1.f},
+		gmtl::Vec3f{1.f, 0.f, 1.f},
+		gmtl::Vec3f{1.f, 1.f, 0.f}
 	};
 
-	std::string projection = "Z";
+	std::atomic<int> projection = {PROJECT_Z};
 
-	gmtl::Quatf sphereQuat;
-	gmtl::Quatf rotationAccumulation;
 	gmtl::Vec3f xPointOnSphere;
 	gmtl::Vec3f yPointOnSphere;
 	gmtl::Vec3f zPointOnSphere;
@@ -112,49 +118,29 @@ struct QuatOSC : QuestionableModule {
 	// logically linked to VOCT{N}_OCT param
 	std::vector<bool> quantizedVOCT {true,true,true};
 	bool normalizeSpreadVolume = true;
+	// polynomial lfo sin and dephase asin instead of libm
+	bool fastMath = true;
 
 	float clockFreq = 2.f;
 	
 	// when manipulating the lfos they will always be sligtly out of phase.
 	// random phase to start for more consistant inconsitency :)
-	float lfo1Phase = 0.8364f;
-	float lfo2Phase = 0.435f;
-	float lfo3Phase = 0.3234f;
-
-	// statically allocated queue
-	// the less allocation going in the audio thread the better
-	template <typename T, const size_t allocation_size=SAMPLES_PER_SECOND*2> // around 1mb for 16 voices
-	struct SLURPQueue {
-		T* values;
-		size_t cursor_front = 0;
-		size_t cursor_back = 0;
-		size_t s = 0;
-		SLURPQueue() { values = new T[allocation_size]; } // not limited by stack
-		~SLURPQueue() { delete [] values; }
-		T pop() {
-			if (s > 0) {
-				size_t grab = cursor_back;
-				cursor_back = (cursor_back+1) % allocation_size;
-				s -= 1;
-				return values[grab];
-			}
-			return T();
-		}
-		void push(T obj) {
-			if (s >= allocation_size) return; // not important for us
-			cursor_front = (cursor_front+1) % allocation_size;
-			s += 1;
-			values[cursor_front] = obj;
-		}
-		size_t size() { return s; }
-	};
-	
-	struct pointSampleGroup {
-		SLURPQueue<gmtl::Vec3f> x;
-		SLURPQueue<gmtl::Vec3f> y;
-		SLURPQueue<gmtl::Vec3f> z;
+	const float lfoStartPhases[3] = {0.8364f, 0.435f, 0.3234f};
+
+	// Oscillator state for every VOct channel, one lane per channel. A mono patch only uses channel 0.
+	struct alignas(16) VoiceQuats {
+		float x[MAX_SPREAD];
+		float y[MAX_SPREAD];
+		float z[MAX_SPREAD];
+		float w[MAX_SPREAD];
+
+		gmtl::Quatf get(int i) const { return gmtl::Quatf(x[i], y[i], z[i], w[i]); }
+		void set(int i, const gmtl::Quatf& q) { x[i] = q[gmtl::Xi]; y[i] = q[gmtl::Yi]; z[i] = q[gmtl::Zi]; w[i] = q[gmtl::Wi]; }
 	};
-	pointSampleGroup pointSamples[MAX_SPREAD];
+	VoiceQuats sphereQuats;
+	VoiceQuats rotationAccumulations;
+	float lfoPhases[3][MAX_SPREAD];
+	int polyChannels = 1;
 
 	bool oct1Connected = false;
 	bool oct2Connected = false;
@@ -200,11 +186,22 @@ struct QuatOSC : QuestionableModule {
 		configInput(TRIGGER, "Gate");
 
 		supportsSampleRateOverride = true;
+		supportsOversampling = true;
+		supportsQualityGovernor = true;
+		idleOutputs = {OUT, OUT2};
 
 		xPointOnSphere = gmtl::Vec3f(VECLENGTH, 0.f, 0.f);
 		yPointOnSphere = gmtl::Vec3f(0.f, VECLENGTH, 0.f);
 		zPointOnSphere = gmtl::Vec3f(0.f, 0.f, VECLENGTH);
-		
+
+		for (int ch = 0; ch < MAX_SPREAD; ch++) rotationAccumulations.set(ch, gmtl::Quatf(0,0,0,1));
+		resetPhase(true);
+	}
+
+	~QuatOSC() {
+		delete freezeTable;
+		delete freezeMailbox.load();
+		delete freezeRetired.load();
 	}
 
 	inline float fclamp(float min, float max, float value) {
@@ -216,27 +213,31 @@ struct QuatOSC : QuestionableModule {
 		else return params[value].getValue() + inputs[value + VOCT1_OCT_INPUT].getVoltage();
 	}
 
+	// from the low tier on the governor drops spread voices, the rate divider is handled by QuestionableModule
 	inline int getSpread() {
-		return (int)params[SPREAD].getValue();
+		int spread = (int)params[SPREAD].getValue();
+		if (qualityTier >= QUALITY_LOW) spread = std::max(1, spread >> (qualityTier - QUALITY_REDUCED));
+		return spread;
 	}
 
-	// Covert a 3d point in space to a 1d high value on a plane.
-	inline float VecCombine(gmtl::Vec3f vector) {
-		gmtl::Vec3f proj = projectionPlanes[projection];
-		return (vector[0]*proj[0]) + (vector[1]*proj[1]) + (vector[2]*proj[2]);
+	inline int getOversample() {
+		return qualityTier > QUALITY_FULL ? 1 : std::max(1, oversample);
 	}
 
-	inline float calcVOctFreq(int input) {
+	inline float calcVOctFreq(int input, int channel) {
 		float voctOffset = quantizedVOCT[input] ? std::round(getValue(input)) : getValue(input);
 		if (voctOffset < 0.f) return params[DEPHASE].getValue() == 0.f ? 1.f : 0.f;
-		return HALF_SEMITONE * (clockFreq / 2.f) * dsp::approxExp2_taylor5((inputs[input].getVoltage() + voctOffset) + 30.f) / std::pow(2.f, 30.f);
+		return HALF_SEMITONE * (clockFreq / 2.f) * dsp::approxExp2_taylor5((inputs[input].getPolyVoltage(channel) + voctOffset) + 30.f) / std::pow(2.f, 30.f);
 	}
 
 	float syncClockOffset = 0.f;
 
-	inline float processLFO(float &phase, float frequency, const ProcessArgs& args, int voct = -1) {
-		float voctFreq = calcVOctFreq(voct);
+	// the divided frame count is derived from the engine frame, so only the offset has to start over
+	void onRateDividerChange() override {
+		syncClockOffset = 0.f;
+	}
 
+	inline void advanceLFO(float &phase, float frequency, float voctFreq, const ProcessArgs& args) {
 		if (params[DEPHASE].getValue() == 1.f) { // new dephase
 			double time = ((args.frame/args.sampleRate) - syncClockOffset);
 			double perfectPhase = (voctFreq * time) + frequency;
@@ -245,59 +246,181 @@ struct QuatOSC : QuestionableModule {
 			phase += phaseErr * args.sampleTime * 25;
 		}
 
-		phase += ((frequency) + (voct != -1 ? voctFreq : 0.f)) * args.sampleTime;
+		phase += ((frequency) + voctFreq) * args.sampleTime;
 		phase -= trunc(phase);
+	}
+
+	// same as advanceLFO for the four channels starting at phases, returns the lfo values
+	inline simd::float_4 processLFOGroup(float* phases, const float* voctFreqs, float frequency, const ProcessArgs& args) {
+		simd::float_4 phase = simd::float_4::load(phases);
+		simd::float_4 voctFreq = simd::float_4::load(voctFreqs);
+		if (params[DEPHASE].getValue() == 1.f) { // new dephase
+			// the perfect phase needs doubles once the frame count gets large, so it stays per channel
+			double time = ((args.frame/args.sampleRate) - syncClockOffset);
+			simd::float_4 perfectPhase;
+			for (int i = 0; i < 4; i++) {
+				double channelPhase = (voctFreqs[i] * time) + frequency;
+				perfectPhase[i] = channelPhase - trunc(channelPhase);
+			}
+			phase += (perfectPhase - phase) * (args.sampleTime * 25);
+		}
 
-		return sin(2.f * M_PI * phase);
+		phase += (frequency + voctFreq) * args.sampleTime;
+		phase -= simd::trunc(phase);
+		phase.store(phases);
+		return fastMath ? fastmath::sin2pi(phase) : simd::sin((float)(2.0 * M_PI) * phase);
 	}
 
 	void resetPhase(bool resetLfo=false) {
-		sphereQuat = gmtl::Quatf(0,0,0,1);
-		if (resetLfo) {
-			lfo1Phase = 0.8364f;
-			lfo2Phase = 0.435f;
-			lfo3Phase = 0.3234f;
+		for (int ch = 0; ch < MAX_SPREAD; ch++) {
+			sphereQuats.set(ch, gmtl::Quatf(0,0,0,1));
+			if (resetLfo) for (int a = 0; a < 3; a++) lfoPhases[a][ch] = lfoStartPhases[a];
 		}
 	}
 
-	inline float smoothDephase(float offset, float phase, float sampleTime) {
-		float phaseError = std::asin(phase) - std::asin(offset);
-		if (phaseError > M_PI) phaseError -= 2*M_PI;
-		else if (phaseError < -M_PI) phaseError += 2*M_PI;
-		return lerp<float>(phase, phase - (phaseError), sampleTime);
-	}
+	enum ControlId {
+		LFO_X_INFLUENCE,
+		LFO_Y_INFLUENCE,
+		LFO_Z_INFLUENCE,
+		X_ROTATION,
+		Y_ROTATION,
+		Z_ROTATION,
+		X_POSITION,
+		Y_POSITION,
+		Z_POSITION,
+		CONTROLS_LEN
+	};
 
-	// Convert a 3 point set of 3d positions to stereo data
-	// TODO: can be optimized?
-	inline std::vector<float> pointToStereo(gmtl::Vec3f* points) {
-		std::vector<float> stereo = {0.0f, 0.0f};
+	// knob and cv derived values, evaluated once every controlBlockSize samples and ramped in between
+	float controls[CONTROLS_LEN] = {};
+	float controlSteps[CONTROLS_LEN] = {};
+	// lfo frequencies follow the VOct channels so they get ramped per channel
+	float lfoFreqs[3][MAX_SPREAD] = {};
+	float lfoFreqSteps[3][MAX_SPREAD] = {};
+	int controlBlockSize = 16;
+	int controlCounter = 0;
+	bool controlsReady = false;
+	bool audioRateModulation = false;
+	bool voct3Off = false;
+
+	bool modulationConnected() {
+		for (int i = VOCT; i <= VOCT3; i++) if (inputs[i].isConnected()) return true;
+		for (int i = VOCT1_OCT_INPUT; i <= Z_POS_I_INPUT; i++) if (inputs[i].isConnected()) return true;
+		return false;
+	}
 
-		for (size_t i = 0; i < 3; i++) {
-			float vecProjected = VecCombine(points[i]);
-			// add each sides influence
-			// TODO: double check to see if this changes when projected differently. it shoud.
-			stereo[0] += fclamp(-1, 0, points[i][0]) * (vecProjected * getValue(X_POS_I_PARAM+i, true));
-			stereo[1] += fclamp(0, 1, points[i][0]) * (vecProjected * getValue(X_POS_I_PARAM+i, true));
-
-			if (params[STEREO].getValue() == Stereo::FULL) {
-				// add center influence
-				for (size_t x = 0; x < 2; x++) {
-					stereo[x] += (1-fclamp(0, 1, abs(points[i][0]))) * (vecProjected * getValue(X_POS_I_PARAM+i, true));
-				}
+	void evaluateControls(int block) {
+		// every spread voice gets its own output channel per VOct channel, so fewer channels fit the wider the spread
+		int lastChannels = controlsReady ? polyChannels : 0;
+		polyChannels = std::max(1, std::max(inputs[VOCT].getChannels(), std::max(inputs[VOCT2].getChannels(), inputs[VOCT3].getChannels())));
+		polyChannels = std::min(polyChannels, MAX_SPREAD / getSpread());
+
+		float targets[CONTROLS_LEN];
+		for (int a = 0; a < 3; a++) {
+			targets[LFO_X_INFLUENCE+a] = getValue(X_FLO_I_PARAM+a, true);
+			targets[X_ROTATION+a] = getValue(X_FLO_ROT_PARAM+a);
+			targets[X_POSITION+a] = getValue(X_POS_I_PARAM+a, true);
+
+			for (int ch = 0; ch < polyChannels; ch++) {
+				float freq = calcVOctFreq(VOCT+a, ch);
+				if (ch >= lastChannels) lfoFreqs[a][ch] = freq;
+				lfoFreqSteps[a][ch] = (freq - lfoFreqs[a][ch]) / block;
 			}
 		}
+		voct3Off = getValue(VOCT3) < 0;
 
-		return stereo;
+		for (int i = 0; i < CONTROLS_LEN; i++) {
+			if (!controlsReady) controls[i] = targets[i];
+			controlSteps[i] = (targets[i] - controls[i]) / block;
+		}
+		controlsReady = true;
 	}
 
-	inline int getVisualSampleRate() {
-		return sampleRateOverride == 0 ? SAMPLES_PER_SECOND : sampleRateOverride;
+	inline void advanceControls() {
+		if (controlCounter <= 0) {
+			int block = (audioRateModulation && modulationConnected()) ? 1 : controlBlockSize;
+			evaluateControls(block);
+			controlCounter = block;
+		}
+		controlCounter--;
+		for (int i = 0; i < CONTROLS_LEN; i++) controls[i] += controlSteps[i];
+		for (int a = 0; a < 3; a++) {
+			for (int ch = 0; ch < polyChannels; ch++) lfoFreqs[a][ch] += lfoFreqSteps[a][ch];
+		}
 	}
 
-	void processUndersampled(const ProcessArgs& args) override {
-		gmtl::Quatf rotOffset;
+	// pull four lfo phases back towards zero, asin keeps the error inside +-pi so it never wraps
+	inline simd::float_4 smoothDephase(simd::float_4 phase, float sampleTime) {
+		simd::float_4 phaseError;
+		if (fastMath) phaseError = fastmath::asin(phase);
+		else for (int i = 0; i < 4; i++) phaseError[i] = std::asin(phase[i]);
+		return lerp<simd::float_4>(phase, phase - phaseError, sampleTime);
+	}
 
-		// clock stuff from lfo
+	// move the lfos and the accumulated rotations of the four channels starting at c on by one sample
+	// and update their sphere rotations. Lanes past polyChannels are advanced too, nothing reads them.
+	inline void advanceSphereGroup(const ProcessArgs& args, int c) {
+		using simd::float_4;
+		bool oldDephase = params[DEPHASE].getValue() == 0.f;
+
+		// pure quat rotation from lfos
+		float_4 lfo[3];
+		for (int a = 0; a < 3; a++) {
+			if (!oldDephase && a == 2 && voct3Off) lfo[a] = 0.95f;
+			else lfo[a] = controls[LFO_X_INFLUENCE+a] * processLFOGroup(&lfoPhases[a][c], &lfoFreqs[a][c], oldDephase ? 0.f : lfoStartPhases[a], args);
+		}
+		// normalize, leaving near zero quats alone like gmtl does
+		float_4 len = simd::sqrt(lfo[0]*lfo[0] + lfo[1]*lfo[1] + lfo[2]*lfo[2]);
+		float_4 invLen = simd::ifelse(len < 0.0001f, 1.f, 1.f / len);
+		float_4 ox = lfo[0] * invLen;
+		float_4 oy = lfo[1] * invLen;
+		float_4 oz = lfo[2] * invLen;
+
+		// quat constant rotation addition, rotationAccumulation += rotAddition * rotationAccumulation
+		float_4 ax = float_4::load(&rotationAccumulations.x[c]);
+		float_4 ay = float_4::load(&rotationAccumulations.y[c]);
+		float_4 az = float_4::load(&rotationAccumulations.z[c]);
+		float_4 aw = float_4::load(&rotationAccumulations.w[c]);
+		float rx = controls[X_ROTATION] * args.sampleTime;
+		float ry = controls[Y_ROTATION] * args.sampleTime;
+		float rz = controls[Z_ROTATION] * args.sampleTime;
+		float_4 dx = rx*aw + ry*az - rz*ay;
+		float_4 dy = ry*aw + rz*ax - rx*az;
+		float_4 dz = rz*aw + rx*ay - ry*ax;
+		float_4 dw = -(rx*ax + ry*ay + rz*az);
+		ax += dx; ay += dy; az += dz; aw += dw;
+
+		// add our lfo rotation to our accumulated rotation, sphere = rotationAccumulation * rotOffset
+		float_4 sx = aw*ox + ay*oz - az*oy;
+		float_4 sy = aw*oy + az*ox - ax*oz;
+		float_4 sz = aw*oz + ax*oy - ay*ox;
+		float_4 sw = -(ax*ox + ay*oy + az*oz);
+		len = simd::sqrt(sx*sx + sy*sy + sz*sz + sw*sw);
+		invLen = simd::ifelse(len < 0.0001f, 1.f, 1.f / len);
+		(sx * invLen).store(&sphereQuats.x[c]);
+		(sy * invLen).store(&sphereQuats.y[c]);
+		(sz * invLen).store(&sphereQuats.z[c]);
+		(sw * invLen).store(&sphereQuats.w[c]);
+
+		// smooth dephase, less clicking :) same as gmtl::lerp towards identity, which renormalizes
+		ax = lerp<float_4>(ax, 0.f, args.sampleTime);
+		ay = lerp<float_4>(ay, 0.f, args.sampleTime);
+		az = lerp<float_4>(az, 0.f, args.sampleTime);
+		aw = lerp<float_4>(aw, 1.f, args.sampleTime);
+		len = simd::sqrt(ax*ax + ay*ay + az*az + aw*aw);
+		invLen = simd::ifelse(len < 0.0001f, 1.f, 1.f / len);
+		(ax * invLen).store(&rotationAccumulations.x[c]);
+		(ay * invLen).store(&rotationAccumulations.y[c]);
+		(az * invLen).store(&rotationAccumulations.z[c]);
+		(aw * invLen).store(&rotationAccumulations.w[c]);
+
+		//dephase
+		if (oldDephase) { // old style
+			for (int a = 0; a < 3; a++) smoothDephase(float_4::load(&lfoPhases[a][c]), args.sampleTime).store(&lfoPhases[a][c]);
+		}
+	}
+
+	void processClock(const ProcessArgs& args) {
 		if (inputs[CLOCK_INPUT].isConnected()) {
 			clockTimer.process(args.sampleTime);
 			//if (1.f / clockTimer.getTime() < clockFreq) clockFreq = std::max(0.1f, 1.f / clockTimer.getTime());
@@ -310,82 +433,403 @@ struct QuatOSC : QuestionableModule {
 				}
 			}
 		} else clockFreq = 2.f;
+	}
+
+	// nothing is patched, keep the spheres turning for the display and skip the voices
+	void processIdle(const ProcessArgs& args) override {
+		processClock(args);
+		advanceControls();
+
+		// the frozen cycle and the lfos drift apart while idle, so record a fresh one after
+		if (freezeState != FREEZE_LIVE) {
+			freezeState = FREEZE_LIVE;
+			freezeHold = 0;
+		}
 
-		// quat rotation from lfos
-		if (params[DEPHASE].getValue() == 0.f) {
-			rotOffset = gmtl::makePure(gmtl::Vec3f(
-				getValue(X_FLO_I_PARAM, true)  * ((processLFO(lfo1Phase, 0, args, VOCT))), 
-				getValue(Y_FLO_I_PARAM, true)  * ((processLFO(lfo2Phase, 0, args, VOCT2))), 
-				getValue(Z_FLO_I_PARAM, true)  * ((processLFO(lfo3Phase, 0, args, VOCT3)))
-			));
+		for (int c = 0; c < polyChannels; c += 4) advanceSphereGroup(args, c);
+		captureSphere(args);
+	}
+
+	void processUndersampled(const ProcessArgs& args) override {
+		NoAllocScope noAlloc;
+
+		// clock stuff from lfo
+		processClock(args);
+		advanceControls();
+
+		if (updateFreeze(args)) {
+			playFrozenCycle(args);
+			return;
+		}
+
+		// spread polyphonic logic, every VOct channel gets its own run of spread voices
+		int spread = getSpread();
+		// spread can grow between control evaluations, knob or governor, keep the voices within the outputs
+		polyChannels = std::min(polyChannels, MAX_SPREAD / spread);
+		int voices = spread * polyChannels;
+		outputs[OUT].setChannels(voices);
+		outputs[OUT2].setChannels(voices);
+		float volDec = normalizeSpreadVolume ? (spread>1 ? 2*math::log2(spread) : 1) : 1;
+
+		if (spread != voiceOffsetsSpread || polyChannels != voiceOffsetsChannels) {
+			buildVoiceOffsets(voiceOffsets, spread, polyChannels);
+			voiceOffsetsSpread = spread;
+			voiceOffsetsChannels = polyChannels;
+		}
+
+		const gmtl::Vec3f& plane = projectionPlanes[projection];
+		VoiceMix mix;
+		mix.stereo = (int)params[STEREO].getValue();
+		mix.volDec = volDec;
+		for (int a = 0; a < 3; a++) {
+			mix.plane[a] = plane[a];
+			mix.influence[a] = controls[X_POSITION+a];
+		}
+
+		int os = getOversample();
+		if (os != lastOversample) {
+			for (int o = 0; o < 2; o++) {
+				for (int g = 0; g < MAX_SPREAD/4; g++) {
+					decimator2[o][g].reset();
+					decimator4[o][g].reset();
+					decimator8[o][g].reset();
+				}
+			}
+			lastOversample = os;
+		}
+
+		if (os == 1) {
+			const VoiceQuats& spheres = advanceSpheres(args, spread, voices);
+			for (int c = 0; c < voices; c += 4) {
+				simd::float_4 left, right;
+				processVoiceGroup(c, spheres, mix, left, right);
+				outputs[OUT].setVoltageSimd(left, c);
+				outputs[OUT2].setVoltageSimd(right, c);
+			}
 		} else {
-			rotOffset = gmtl::makePure(gmtl::Vec3f(
-				getValue(X_FLO_I_PARAM, true)  * ((processLFO(lfo1Phase, 0.8364f, args, VOCT))), 
-				getValue(Y_FLO_I_PARAM, true)  * ((processLFO(lfo2Phase, 0.435f, args, VOCT2))), 
-				(getValue(VOCT3) < 0) ? 0.95 : getValue(Z_FLO_I_PARAM, true)  * ((processLFO(lfo3Phase, 0.3234f, args, VOCT3)))
-			));
+			// run the whole voice loop at the higher rate and filter it back down
+			ProcessArgs osArgs = args;
+			osArgs.sampleRate = args.sampleRate * os;
+			osArgs.sampleTime = args.sampleTime / os;
+			for (int k = 0; k < os; k++) {
+				osArgs.frame = args.frame * os + k;
+				const VoiceQuats& spheres = advanceSpheres(osArgs, spread, voices);
+				for (int c = 0; c < voices; c += 4) processVoiceGroup(c, spheres, mix, oversampleBuffer[0][c/4][k], oversampleBuffer[1][c/4][k]);
+			}
+			for (int c = 0; c < voices; c += 4) {
+				outputs[OUT].setVoltageSimd(decimate(os, 0, c/4), c);
+				outputs[OUT2].setVoltageSimd(decimate(os, 1, c/4), c);
+			}
 		}
-		gmtl::normalize(rotOffset);
 
-		// quat constant rotation addition
-		gmtl::Quatf rotAddition = gmtl::makePure(gmtl::Vec3f(
-			getValue(X_FLO_ROT_PARAM) * args.sampleTime, 
-			getValue(Y_FLO_ROT_PARAM) * args.sampleTime, 
-			getValue(Z_FLO_ROT_PARAM) * args.sampleTime
-		));
-		rotationAccumulation += rotAddition * rotationAccumulation;
+		if (freezeState == FREEZE_RECORDING) recordFrozenCycle(spread);
 
-		sphereQuat = rotationAccumulation * rotOffset; // add our lfo rotation to our accumulated rotation
+		captureSphere(args);
+	}
 
-		gmtl::lerp(rotationAccumulation, args.sampleTime, rotationAccumulation, gmtl::Quatf(0,0,0,1)); // smooth dephase, less clicking :)
+	// sphere rotation of the channel each voice belongs to
+	VoiceQuats voiceSpheres;
 
-		gmtl::normalize(sphereQuat);
+	inline const VoiceQuats& advanceSpheres(const ProcessArgs& args, int spread, int voices) {
+		for (int c = 0; c < polyChannels; c += 4) advanceSphereGroup(args, c);
+		if (spread == 1) return sphereQuats;
 
-		//dephase
-		if (params[DEPHASE].getValue() == 0.f) { // old style
-			lfo1Phase = smoothDephase(0, lfo1Phase, args.sampleTime);
-			lfo2Phase = smoothDephase(0, lfo2Phase, args.sampleTime);
-			lfo3Phase = smoothDephase(0, lfo3Phase, args.sampleTime);
+		for (int v = 0; v < voices; v++) voiceSpheres.set(v, sphereQuats.get(v / spread));
+		return voiceSpheres;
+	}
+
+	// Rotation of the sphere captured for the display, it applies the spread offsets itself. Single writer ring,
+	// the display copies out what it needs and throws away anything the audio thread lapped while it was copying.
+	static const uint32_t CAPTURE_SIZE = 512; // a bit more than MAX_HISTORY so the display has some slack
+	gmtl::Quatf captures[CAPTURE_SIZE];
+	std::atomic<uint32_t> captureCount = {0};
+
+	inline void captureSphere(const ProcessArgs& args) {
+		// only capture at the visual sample rate
+		if (args.frame % (int)(args.sampleRate/std::fmin(SAMPLES_PER_SECOND, args.sampleRate)) != 0) return;
+		uint32_t captureIndex = captureCount.load(std::memory_order_relaxed);
+		// the display checks captureCount again after copying, keep this write from showing up before the last publish
+		std::atomic_thread_fence(std::memory_order_release);
+		captures[captureIndex % CAPTURE_SIZE] = sphereQuats.get(0);
+		captureCount.store(captureIndex + 1, std::memory_order_release);
+	}
+
+	// Cycle freeze. With no cables in, still knobs, no constant rotation and the new dephase (which locks the lfo
+	// phases to time) the output repeats every period of the slowest lfo, as long as the others run at whole
+	// multiples of it. In that case one period is recorded while running live and then played back until anything changes.
+	// The old dephase bends every lfo phase by its own asin feedback so it never has a known period and stays live.
+	enum FreezeState {
+		FREEZE_LIVE,
+		FREEZE_RECORDING,
+		FREEZE_PLAYING
+	};
+
+	static const int FREEZE_TABLE_SIZE = 1 << 20; // largest table a cycle can ask for
+	static const int FREEZE_MAX_STEP = 8;
+	const float FREEZE_HOLD_TIME = 0.5f;
+
+	bool cycleFreeze = true;
+	FreezeState freezeState = FREEZE_LIVE;
+	// Only allocated once a cycle wants freezing, sized to that cycle and only ever grown. The audio thread asks
+	// through freezeRequest, the widget allocates into freezeMailbox and frees what comes back in freezeRetired.
+	std::vector<float>* freezeTable = nullptr;
+	std::atomic<int> freezeRequest = {0};
+	std::atomic<std::vector<float>*> freezeMailbox = {nullptr};
+	std::atomic<std::vector<float>*> freezeRetired = {nullptr};
+	int freezeProvided = 0; // ui thread only
+	float freezeParams[PARAMS_LEN] = {};
+	int freezeProjection = PROJECT_Z;
+	bool freezeNormalize = true;
+	bool freezeFastMath = true;
+	float freezeSampleRate = 0.f;
+	int freezeOversample = 1;
+	int freezeTier = QUALITY_FULL;
+	int freezeHold = 0;
+	double freezePeriod = 0.0; // in samples
+	double freezePos = 0.0;
+	int freezeStep = 1; // samples between recorded rows
+	int freezeRowSize = 0;
+	int freezeRecorded = 0;
+
+	bool freezeSnapshotMatches(float sampleRate) {
+		for (int i = 0; i < INPUTS_LEN; i++) if (inputs[i].isConnected()) return false;
+		for (int i = 0; i < PARAMS_LEN; i++) if (params[i].getValue() != freezeParams[i]) return false;
+		return projection == freezeProjection && normalizeSpreadVolume == freezeNormalize && fastMath == freezeFastMath && sampleRate == freezeSampleRate && getOversample() == freezeOversample && qualityTier == freezeTier;
+	}
+
+	void takeFreezeSnapshot(float sampleRate) {
+		for (int i = 0; i < PARAMS_LEN; i++) freezeParams[i] = params[i].getValue();
+		freezeProjection = projection;
+		freezeNormalize = normalizeSpreadVolume;
+		freezeFastMath = fastMath;
+		freezeSampleRate = sampleRate;
+		freezeOversample = getOversample();
+		freezeTier = qualityTier;
+	}
+
+	// returns true when the frozen cycle should be played instead of computing the sample
+	bool updateFreeze(const ProcessArgs& args) {
+		if (!cycleFreeze || !freezeSnapshotMatches(args.sampleRate)) {
+			takeFreezeSnapshot(args.sampleRate);
+			freezeState = FREEZE_LIVE;
+			freezeHold = 0;
+			return false;
+		}
+
+		if (freezeState == FREEZE_LIVE && ++freezeHold >= args.sampleRate * FREEZE_HOLD_TIME) {
+			freezeHold = 0;
+			startFreezeRecording(args);
+		}
+
+		return freezeState == FREEZE_PLAYING;
+	}
+
+	void startFreezeRecording(const ProcessArgs& args) {
+		if (params[DEPHASE].getValue() != 1.f) return;
+		for (int a = 0; a < 3; a++) if (params[X_FLO_ROT_PARAM+a].getValue() != 0.f) return;
+
+		// wait for any old rotation to settle back home
+		if (std::abs(rotationAccumulations.w[0]) < 0.999999f) return;
+		rotationAccumulations.set(0, gmtl::Quatf(0,0,0,1));
+
+		float freqs[3];
+		float slowest = 0.f;
+		for (int a = 0; a < 3; a++) {
+			bool moving = controls[LFO_X_INFLUENCE+a] != 0.f && lfoFreqs[a][0] > 0.f && !(a == 2 && voct3Off);
+			freqs[a] = moving ? lfoFreqs[a][0] : 0.f;
+			if (moving && (slowest == 0.f || freqs[a] < slowest)) slowest = freqs[a];
+		}
+		for (int a = 0; a < 3; a++) {
+			if (freqs[a] == 0.f) continue;
+			float ratio = freqs[a] / slowest;
+			if (std::abs(ratio - std::round(ratio)) > 1e-4f * ratio) return;
+		}
+
+		// nothing moving means a constant output, any period will do
+		double period = slowest > 0.f ? args.sampleRate / slowest : 1.0;
+		int rowSize = getSpread() * 2 + 4;
+		int maxRows = FREEZE_TABLE_SIZE / rowSize;
+		int step = 1;
+		while ((int)((period + step) / step) + 1 > maxRows) {
+			if (++step > FREEZE_MAX_STEP) return;
+		}
+
+		// not recording yet if the table is too small, the widget grows it and the next hold tries again
+		int needed = ((int)((period + step) / step) + 2) * rowSize;
+		if (std::vector<float>* fresh = freezeMailbox.exchange(nullptr)) {
+			freezeRetired.store(freezeTable);
+			freezeTable = fresh;
+		}
+		if (!freezeTable || (int)freezeTable->size() < needed) {
+			freezeRequest.store(needed);
+			return;
+		}
+
+		freezePeriod = period;
+		freezeStep = step;
+		freezeRowSize = rowSize;
+		freezeRecorded = 0;
+		freezeState = FREEZE_RECORDING;
+	}
+
+	// ui thread, hands the audio thread a bigger table when it asked for one
+	void serviceFreezeTable() {
+		delete freezeRetired.exchange(nullptr);
+		int request = freezeRequest.load();
+		if (request > freezeProvided && !freezeMailbox.load()) {
+			freezeMailbox.store(new std::vector<float>(request));
+			freezeProvided = request;
+		}
+	}
+
+	inline void recordFrozenCycle(int spread) {
+		if (freezeRecorded % freezeStep == 0) {
+			float* row = &(*freezeTable)[(freezeRecorded / freezeStep) * freezeRowSize];
+			for (int c = 0; c < spread; c++) {
+				row[c*2] = outputs[OUT].getVoltage(c);
+				row[c*2+1] = outputs[OUT2].getVoltage(c);
+			}
+			gmtl::Quatf sphereQuat = sphereQuats.get(0);
+			for (int i = 0; i < 4; i++) row[spread*2+i] = sphereQuat[i];
+		}
+
+		freezeRecorded++;
+		// rows have to reach one step past the end of the period for interpolation
+		if (freezeRecorded > freezePeriod + freezeStep) {
+			freezePos = std::fmod((double)freezeRecorded, freezePeriod);
+			freezeState = FREEZE_PLAYING;
+		}
+	}
+
+	void playFrozenCycle(const ProcessArgs& args) {
+		// keep the lfos moving so going back to live doesn't jump
+		for (int a = 0; a < 3; a++) {
+			if (a == 2 && voct3Off) continue;
+			advanceLFO(lfoPhases[a][0], lfoStartPhases[a], lfoFreqs[a][0], args);
 		}
 
-		// spread polyphonic logic
 		int spread = getSpread();
 		outputs[OUT].setChannels(spread);
 		outputs[OUT2].setChannels(spread);
-		float volDec = normalizeSpreadVolume ? (spread>1 ? 2*math::log2(spread) : 1) : 1;
-		for (int i = 0; i < spread; i++) {
+
+		double index = freezePos / freezeStep;
+		int i0 = (int)index;
+		float t = (float)(index - i0);
+		const float* a = &(*freezeTable)[i0 * freezeRowSize];
+		const float* b = a + freezeRowSize;
+		for (int c = 0; c < spread; c++) {
+			outputs[OUT].setVoltage(crossfade(a[c*2], b[c*2], t), c);
+			outputs[OUT2].setVoltage(crossfade(a[c*2+1], b[c*2+1], t), c);
+		}
+
+		gmtl::Quatf sphereQuat;
+		for (int i = 0; i < 4; i++) sphereQuat[i] = crossfade(a[spread*2+i], b[spread*2+i], t);
+		gmtl::normalize(sphereQuat);
+		sphereQuats.set(0, sphereQuat);
+		captureSphere(args);
+
+		freezePos += 1.0;
+		if (freezePos >= freezePeriod) freezePos -= freezePeriod;
+	}
+
+	// spread voice offset rotations, one lane per output voice
+	VoiceQuats voiceOffsets;
+	int voiceOffsetsSpread = 0;
+	int voiceOffsetsChannels = 0;
+
+	// offset rotations only depend on the spread, so only rebuild them when it changes
+	static void buildVoiceOffsets(VoiceQuats& voiceOffsets, int spread, int channels = 1) {
+		for (int v = 0; v < MAX_SPREAD; v++) {
 			gmtl::Quatf offsetRot = gmtl::Quatf();
+			int i = v % spread;
+
+			if (v < spread * channels) {
+				if (spread%2) gmtl::set(offsetRot, gmtl::EulerAngleXYZf((i-spread/2)*(M_PI/spread), (i-spread/2)*(M_PI/spread), (i-spread/2)*(M_PI/spread)));
+				else gmtl::set(offsetRot, gmtl::EulerAngleXYZf((i-spread/M_PI)*(M_PI/spread), (i-spread/M_PI)*(M_PI/spread), (i-spread/M_PI)*(M_PI/spread)));
+			}
+
+			voiceOffsets.set(v, offsetRot);
+		}
+	}
+
+	struct VoiceMix {
+		simd::float_4 plane[3];
+		simd::float_4 influence[3];
+		int stereo = Stereo::FULL;
+		float volDec = 1.f;
+	};
+
+	// Rotate, project and mix 4 voices starting at channel c.
+	// Same math as rotating the three points on the sphere by sphere * offset and normalizing them,
+	// except the rotated axes are read straight from the rotation matrix columns.
+	inline void processVoiceGroup(int c, const VoiceQuats& spheres, const VoiceMix& mix, simd::float_4& left, simd::float_4& right) {
+		simd::float_4 ox = simd::float_4::load(&voiceOffsets.x[c]);
+		simd::float_4 oy = simd::float_4::load(&voiceOffsets.y[c]);
+		simd::float_4 oz = simd::float_4::load(&voiceOffsets.z[c]);
+		simd::float_4 ow = simd::float_4::load(&voiceOffsets.w[c]);
+
+		simd::float_4 sx = simd::float_4::load(&spheres.x[c]);
+		simd::float_4 sy = simd::float_4::load(&spheres.y[c]);
+		simd::float_4 sz = simd::float_4::load(&spheres.z[c]);
+		simd::float_4 sw = simd::float_4::load(&spheres.w[c]);
+
+		// sphere * offset
+		simd::float_4 qx = sw*ox + sx*ow + sy*oz - sz*oy;
+		simd::float_4 qy = sw*oy + sy*ow + sz*ox - sx*oz;
+		simd::float_4 qz = sw*oz + sz*ow + sx*oy - sy*ox;
+		simd::float_4 qw = sw*ow - sx*ox - sy*oy - sz*oz;
+
+		// normalize, leaving near zero quats alone like gmtl does
+		simd::float_4 len = simd::sqrt(qx*qx + qy*qy + qz*qz + qw*qw);
+		simd::float_4 invLen = simd::ifelse(len < 0.0001f, 1.f, 1.f / len);
+		qx *= invLen; qy *= invLen; qz *= invLen; qw *= invLen;
+
+		simd::float_4 xx = qx*qx, yy = qy*qy, zz = qz*qz;
+		simd::float_4 xy = qx*qy, xz = qx*qz, yz = qy*qz;
+		simd::float_4 wx = qw*qx, wy = qw*qy, wz = qw*qz;
+
+		// rotated unit x, y and z axes
+		simd::float_4 axis[3][3] = {
+			{1.f - 2.f*(yy + zz), 2.f*(xy + wz), 2.f*(xz - wy)},
+			{2.f*(xy - wz), 1.f - 2.f*(xx + zz), 2.f*(yz + wx)},
+			{2.f*(xz + wy), 2.f*(yz - wx), 1.f - 2.f*(xx + yy)}
+		};
 
-			if (spread%2) gmtl::set(offsetRot, gmtl::EulerAngleXYZf((i-spread/2)*(M_PI/spread), (i-spread/2)*(M_PI/spread), (i-spread/2)*(M_PI/spread)));
-			else gmtl::set(offsetRot, gmtl::EulerAngleXYZf((i-spread/M_PI)*(M_PI/spread), (i-spread/M_PI)*(M_PI/spread), (i-spread/M_PI)*(M_PI/spread)));
-
-			offsetRot = sphereQuat * offsetRot;
-			gmtl::normalize(offsetRot);
-				
-			gmtl::Vec3f newX = offsetRot * xPointOnSphere;
-			gmtl::Vec3f newY = offsetRot * yPointOnSphere;
-			gmtl::Vec3f newZ = offsetRot * zPointOnSphere;
-			if (((args.frame % (int)(args.sampleRate/std::fmin(SAMPLES_PER_SECOND, args.sampleRate)) == 0)) && !reading) {
-				pointSamples[i].x.push(newX);
-				pointSamples[i].y.push(newY);
-				pointSamples[i].z.push(newZ);
+		left = 0.f;
+		right = 0.f;
+		for (int a = 0; a < 3; a++) {
+			simd::float_4 projected = (axis[a][0]*mix.plane[0] + axis[a][1]*mix.plane[1] + axis[a][2]*mix.plane[2]) * mix.influence[a];
+			if (mix.stereo == Stereo::OFF) {
+				left += projected;
+				continue;
 			}
-			gmtl::normalize(newX); gmtl::normalize(newY); gmtl::normalize(newZ);
-			gmtl::Vec3f points[3] = {newX, newY, newZ};
-			if (params[STEREO].getValue() != Stereo::OFF) {
-				std::vector<float> sStereo = pointToStereo(points);
-				outputs[OUT].setVoltage(sStereo[0] / volDec, i);
-				outputs[OUT2].setVoltage(sStereo[1] / volDec, i);
-			} else {
-				outputs[OUT].setVoltage((
-					((VecCombine(newX) * getValue(X_POS_I_PARAM, true)) + 
-					(VecCombine(newY) * getValue(Y_POS_I_PARAM, true)) + 
-					(VecCombine(newZ) * getValue(Z_POS_I_PARAM, true))) / volDec
-				), i);
-				outputs[OUT2].setVoltage(outputs[OUT].getVoltage(i), i);
+			// add each sides influence
+			left += simd::clamp(axis[a][0], -1.f, 0.f) * projected;
+			right += simd::clamp(axis[a][0], 0.f, 1.f) * projected;
+			// add center influence
+			if (mix.stereo == Stereo::FULL) {
+				simd::float_4 center = (1.f - simd::clamp(simd::fabs(axis[a][0]), 0.f, 1.f)) * projected;
+				left += center;
+				right += center;
 			}
 		}
 
+		left /= mix.volDec;
+		right = mix.stereo == Stereo::OFF ? left : right / mix.volDec;
+	}
+
+	// oversampled voice outputs, [output][voice group][sub sample]
+	simd::float_4 oversampleBuffer[2][MAX_SPREAD/4][8];
+	dsp::Decimator<2, 8, simd::float_4> decimator2[2][MAX_SPREAD/4];
+	dsp::Decimator<4, 8, simd::float_4> decimator4[2][MAX_SPREAD/4];
+	dsp::Decimator<8, 8, simd::float_4> decimator8[2][MAX_SPREAD/4];
+	int lastOversample = 1;
+
+	inline simd::float_4 decimate(int os, int output, int group) {
+		simd::float_4* in = oversampleBuffer[output][group];
+		if (os == 2) return decimator2[output][group].process(in);
+		if (os == 4) return decimator4[output][group].process(in);
+		return decimator8[output][group].process(in);
 	}
 
 	float audioMinima = 0.f;
@@ -393,9 +837,13 @@ struct QuatOSC : QuestionableModule {
 
 	json_t* dataToJson() override {
 		json_t* nodeJ = QuestionableModule::dataToJson();
-		json_object_set_new(nodeJ, "projection", json_string(projection.c_str()));
+		json_object_set_new(nodeJ, "projection", json_string(projectionNames[projection].c_str()));
 		json_object_set_new(nodeJ, "clockFreq", json_real(clockFreq));
 		json_object_set_new(nodeJ, "normalizeSpreadVolume", json_boolean(normalizeSpreadVolume));
+		json_object_set_new(nodeJ, "controlBlockSize", json_integer(controlBlockSize));
+		json_object_set_new(nodeJ, "audioRateModulation", json_boolean(audioRateModulation));
+		json_object_set_new(nodeJ, "fastMath", json_boolean(fastMath));
+		json_object_set_new(nodeJ, "cycleFreeze", json_boolean(cycleFreeze));
 
 		json_t* qtArray = json_array();
 		for (size_t i = 0; i < quantizedVOCT.size(); i++) json_array_append_new(qtArray, json_boolean(quantizedVOCT[i]));
@@ -407,9 +855,15 @@ struct QuatOSC : QuestionableModule {
 	void dataFromJson(json_t* rootJ) override {
 		QuestionableModule::dataFromJson(rootJ);
 		
-		if (json_t* p = json_object_get(rootJ, "projection")) projection = json_string_value(p);
+		if (json_t* p = json_object_get(rootJ, "projection")) {
+			for (int i = 0; i < PROJECTIONS_LEN; i++) if (projectionNames[i] == json_string_value(p)) projection = i;
+		}
 		if (json_t* cf = json_object_get(rootJ, "clockFreq")) clockFreq = json_real_value(cf);
 		if (json_t* nsv = json_object_get(rootJ, "normalizeSpreadVolume")) normalizeSpreadVolume = json_boolean_value(nsv);
+		if (json_t* cbs = json_object_get(rootJ, "controlBlockSize")) controlBlockSize = std::max(1, (int)json_integer_value(cbs));
+		if (json_t* arm = json_object_get(rootJ, "audioRateModulation")) audioRateModulation = json_boolean_value(arm);
+		if (json_t* fm = json_object_get(rootJ, "fastMath")) fastMath = json_boolean_value(fm);
+		if (json_t* cf = json_object_get(rootJ, "cycleFreeze")) cycleFreeze = json_boolean_value(cf);
 		if (json_t* qtArray = json_object_get(rootJ, "quantizedVOCT")) {
 			for (size_t i = 0; i < quantizedVOCT.size(); i++) { 
 				quantizedVOCT[i] = json_boolean_value(json_array_get(qtArray, i)); 
@@ -422,8 +876,12 @@ struct QuatOSC : QuestionableModule {
 
 	void fromJson(json_t* rootJ) override {
 		// reset
-		projection = "Z";
+		projection = PROJECT_Z;
 		normalizeSpreadVolume = true;
+		controlBlockSize = 16;
+		audioRateModulation = false;
+		fastMath = true;
+		cycleFreeze = true;
 		quantizedVOCT = {true,true,true};
 		QuestionableModule::fromJson(rootJ);
 		// reset phase on preset load even if data attribute not found
@@ -454,56 +912,77 @@ struct QuatDisplay : Widget {
 
 	}
 
-	struct vecHistory {
-		gmtl::Vec3f history[MAX_HISTORY+1];
-		int cursor = 0;
-	};
+	// local copy of the captured sphere rotations, historyCursor is the oldest
+	gmtl::Quatf history[MAX_HISTORY];
+	int historyCursor = 0;
+	int historySize = 0;
+	uint32_t lastCapture = 0;
 
-	struct channelHistory {
-		vecHistory x;
-		vecHistory y;
-		vecHistory z;
+	const gmtl::Quatf projRot[QuatOSC::PROJECTIONS_LEN] = {
+		{0.f, 0.7071067, 0.f, 0.7071069},
+		{0.7071067, 0.f, 0.f, 0.7071069},
+		{0.f, 0.f, 0.f, 1.f},
 	};
-	channelHistory history[MAX_SPREAD];
 
-	std::unordered_map<std::string, gmtl::Quatf> projRot = {
-		{"X", {0.f, 0.7071067, 0.f, 0.7071069}},
-		{"Y", {0.7071067, 0.f, 0.f, 0.7071069}},
-		{"Z", {0.f, 0.f, 0.f, 1.f}},
-	};
+	// grab new points from the audio thread and add them to our own history
+	void pullCaptures() {
+		uint32_t head = module->captureCount.load(std::memory_order_acquire);
+		uint32_t start = (head - lastCapture > MAX_HISTORY) ? head - MAX_HISTORY : lastCapture;
 
-	void addToHistory(gmtl::Vec3f vec, vecHistory& h) {
-		h.history[h.cursor] = vec;
-		h.cursor = (h.cursor + 1) % MAX_HISTORY;
+		for (uint32_t i = start; i != head; i++) {
+			history[(historyCursor + historySize) % MAX_HISTORY] = module->captures[i % QuatOSC::CAPTURE_SIZE];
+			if (historySize < MAX_HISTORY) historySize++;
+			else historyCursor = (historyCursor + 1) % MAX_HISTORY;
+		}
+
+		// anything the audio thread started overwriting while we copied is junk, only keep what came after it
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint32_t after = module->captureCount.load(std::memory_order_relaxed);
+		if (after - start >= QuatOSC::CAPTURE_SIZE) {
+			uint32_t valid = (head - start) - std::min(head - start, after - start - QuatOSC::CAPTURE_SIZE + 1);
+			historyCursor = (historyCursor + historySize - valid) % MAX_HISTORY;
+			historySize = valid;
+		}
+
+		lastCapture = head;
 	}
 
-	void drawHistory(NVGcontext* vg, QuatOSC::SLURPQueue<gmtl::Vec3f> &history, NVGcolor color, vecHistory& localHistory) {
-		float centerX = box.size.x/2;
-		float centerY = box.size.y/2;
-		bool f = true;
+	// same spread offsets the module rotates its voices by
+	gmtl::Quatf offsets[MAX_SPREAD];
+	int offsetsSpread = 0;
 
-		gmtl::Quatf rot = (module) ? projRot[((QuatOSC*)module)->projection] : projRot["Z"];
+	void updateOffsets(int spread) {
+		if (spread == offsetsSpread) return;
+		QuatOSC::VoiceQuats voiceOffsets;
+		QuatOSC::buildVoiceOffsets(voiceOffsets, spread);
+		for (int i = 0; i < MAX_SPREAD; i++) offsets[i] = gmtl::Quatf(voiceOffsets.x[i], voiceOffsets.y[i], voiceOffsets.z[i], voiceOffsets.w[i]);
+		offsetsSpread = spread;
+	}
 
-		// grab points from audio thread and clear and add it to our own history list
-		while (history.size() > 1) {
-			addToHistory(history.pop(), localHistory);
+	// rotate one of the points on the sphere
+	static inline gmtl::Vec3f spherePoint(const gmtl::Quatf& q, int axis) {
+		float x = q[gmtl::Xi], y = q[gmtl::Yi], z = q[gmtl::Zi], w = q[gmtl::Wi];
+		switch (axis) {
+			case 0: return gmtl::Vec3f(1.f - 2.f*(y*y + z*z), 2.f*(x*y + w*z), 2.f*(x*z - w*y)) * VECLENGTH;
+			case 1: return gmtl::Vec3f(2.f*(x*y - w*z), 1.f - 2.f*(x*x + z*z), 2.f*(y*z + w*x)) * VECLENGTH;
+			default: return gmtl::Vec3f(2.f*(x*z + w*y), 2.f*(y*z - w*x), 1.f - 2.f*(x*x + y*y)) * VECLENGTH;
 		}
+	}
+
+	void drawHistory(NVGcontext* vg, int voice, int axis, NVGcolor color) {
+		float centerX = box.size.x/2;
+		float centerY = box.size.y/2;
+
+		gmtl::Quatf rot = projRot[module->projection];
 
 		// Iterate from oldest history value to latest
 		nvgBeginPath(vg);
-		for (int i = (localHistory.cursor+1)%MAX_HISTORY; i != localHistory.cursor; i = (i+1)%MAX_HISTORY) {
-			gmtl::Vec3f point = rot * localHistory.history[i];
-
-			/*if (module && module->params[QuatOSC::STEREO].getValue() != QuatOSC::Stereo::OFF) {
-				color.r = clamp<float>(0, 1, color.r + (point[0] / (VECLENGTH)) * 0.003);
-				color.g = clamp<float>(0, 1, color.r + (point[0] / (VECLENGTH)) * 0.003);
-				color.b = clamp<float>(0, 1, color.r + (point[0] / (VECLENGTH)) * 0.003);
-			}
-			nvgStrokeColor(vg, color);*/
-			if (f) nvgMoveTo(vg, centerX + point[0], centerY + point[1]);
-			//else nvgQuadTo(vg, centerX + point[0], centerY + point[1], centerX + point[0], centerY + point[1]);
+		for (int i = 0; i < historySize; i++) {
+			gmtl::Quatf voiceRot = history[(historyCursor + i) % MAX_HISTORY] * offsets[voice];
+			gmtl::normalize(voiceRot);
+			gmtl::Vec3f point = rot * spherePoint(voiceRot, axis);
+			if (i == 0) nvgMoveTo(vg, centerX + point[0], centerY + point[1]);
 			else nvgLineTo(vg, centerX + point[0], centerY + point[1]);
-			f = false;
 		}
 		nvgStrokeColor(vg, color);
 		nvgStrokeWidth(vg, 2.5f);
@@ -512,6 +991,36 @@ struct QuatDisplay : Widget {
 
 	}
 
+	// Figure shown in the module browser, the z trace the old per frame fake history settled into: a full
+	// history of 0, +VECLENGTH, -VECLENGTH repeating, a vertical line through the middle. Built once and
+	// shared by every preview, browsing shouldn't cost any allocation.
+	static const int PREVIEW_POINTS = MAX_HISTORY - 1;
+	struct PreviewFigure {
+		Vec points[PREVIEW_POINTS];
+	};
+
+	static PreviewFigure buildPreviewFigure() {
+		const float pattern[3] = {0.f, VECLENGTH, -VECLENGTH};
+		PreviewFigure figure;
+		for (int i = 0; i < PREVIEW_POINTS; i++) figure.points[i] = Vec(0.f, pattern[i % 3]);
+		return figure;
+	}
+
+	static const PreviewFigure& getPreviewFigure() {
+		static const PreviewFigure figure = buildPreviewFigure();
+		return figure;
+	}
+
+	void drawPreviewTrace(NVGcontext* vg, const Vec* points, NVGcolor color) {
+		Vec center = box.size.div(2);
+		nvgBeginPath(vg);
+		nvgMoveTo(vg, center.x + points[0].x, center.y + points[0].y);
+		for (int i = 1; i < PREVIEW_POINTS; i++) nvgLineTo(vg, center.x + points[i].x, center.y + points[i].y);
+		nvgStrokeColor(vg, color);
+		nvgStrokeWidth(vg, 2.5f);
+		nvgStroke(vg);
+	}
+
 	void drawLayer(const DrawArgs &args, int layer) override {
 
 		nvgSave(args.vg);
@@ -521,12 +1030,8 @@ struct QuatDisplay : Widget {
 
 		if (module == NULL) {
 			// draw example visual
-			QuatOSC::SLURPQueue<gmtl::Vec3f> fakeHistory;
-			fakeHistory.push(gmtl::Vec3f(0, VECLENGTH, 0));
-			fakeHistory.push(gmtl::Vec3f(0, -VECLENGTH, 0));
-			fakeHistory.push(gmtl::Vec3f(0, -VECLENGTH, 0));
-			fakeHistory.push(gmtl::Vec3f(0, VECLENGTH, 0));
-			drawHistory(args.vg, fakeHistory, nvgRGBA(15, 250, 250, 255), history[0].z);
+			const PreviewFigure& figure = getPreviewFigure();
+			drawPreviewTrace(args.vg, figure.points, nvgRGBA(15, 250, 250, 255));
 			nvgRestore(args.vg);
 			return;
 		};
@@ -536,13 +1041,13 @@ struct QuatDisplay : Widget {
 		float zInf = module->getValue(QuatOSC::Z_POS_I_PARAM, true);
 
 		if (layer == 1) {
-			module->reading = true;
+			pullCaptures();
+			updateOffsets(module->getSpread());
 			for (int i = 0; i < module->getSpread(); i++) {
-				drawHistory(args.vg, module->pointSamples[i].x, nvgRGBA(15, 250, 15, xInf*255), history[i].x);
-				drawHistory(args.vg, module->pointSamples[i].y, nvgRGBA(250, 250, 15, yInf*255), history[i].y);
-				drawHistory(args.vg, module->pointSamples[i].z, nvgRGBA(15, 250, 250, zInf*255), history[i].z);
+				drawHistory(args.vg, i, 0, nvgRGBA(15, 250, 15, xInf*255));
+				drawHistory(args.vg, i, 1, nvgRGBA(250, 250, 15, yInf*255));
+				drawHistory(args.vg, i, 2, nvgRGBA(15, 250, 250, zInf*255));
 			}
-			module->reading = false;
 		}
 
 		nvgRestore(args.vg);
@@ -626,6 +1131,11 @@ struct QuatOSCWidget : QuestionableWidget {
 	ImagePanel *fade;
 	QuatDisplay *display;
 
+	void step() override {
+		if (module) ((QuatOSC*)module)->serviceFreezeTable();
+		QuestionableWidget::step();
+	}
+
 	void setText() {
 		NVGcolor c = nvgRGB(255,255,255);
 
@@ -776,12 +1286,28 @@ struct QuatOSCWidget : QuestionableWidget {
 		QuatOSC* mod = (QuatOSC*)module;
 		menu->addChild(new MenuSeparator);
 		menu->addChild(rack::createSubmenuItem("Projection Axis", "", [=](ui::Menu* menu) {
-			menu->addChild(createMenuItem("X", mod->projection == "X" ? "•" : "",[=]() { mod->projection = "X"; }));
-			menu->addChild(createMenuItem("Y", mod->projection == "Y" ? "•" : "", [=]() { mod->projection = "Y"; }));
-			menu->addChild(createMenuItem("Z", mod->projection == "Z" ? "•" : "", [=]() { mod->projection = "Z"; }));
+			for (int i = 0; i < QuatOSC::PROJECTIONS_LEN; i++) {
+				menu->addChild(createMenuItem(mod->projectionNames[i], mod->projection == i ? "•" : "",[=]() { mod->projection = i; }));
+			}
 		}));
 		menu->addChild(createMenuItem(mod->normalizeSpreadVolume ? "Disable Spread Volume Normalization" : "Enable Spread Volume Normalization", "",[=]() { mod->normalizeSpreadVolume = !mod->normalizeSpreadVolume; }));
 		
+		menu->addChild(rack::createSubmenuItem("Control Rate", "", [=](ui::Menu* menu) {
+			std::vector<int> blockSizes = {1, 16, 32};
+			for (int size : blockSizes) {
+				menu->addChild(createMenuItem(size == 1 ? "Every Sample" : "Every " + std::to_string(size) + " Samples", mod->controlBlockSize == size ? "•" : "", [=]() { mod->controlBlockSize = size; }));
+			}
+			menu->addChild(new MenuSeparator);
+			menu->addChild(createMenuItem(mod->audioRateModulation ? "Disable Audio Rate Modulation" : "Enable Audio Rate Modulation", "", [=]() { mod->audioRateModulation = !mod->audioRateModulation; }));
+		}));
+
+		menu->addChild(createMenuItem(mod->cycleFreeze ? "Disable Cycle Freeze" : "Enable Cycle Freeze", mod->freezeState == QuatOSC::FREEZE_PLAYING ? "frozen" : "", [=]() { mod->cycleFreeze = !mod->cycleFreeze; }));
+
+		menu->addChild(rack::createSubmenuItem("Math Precision", "", [=](ui::Menu* menu) {
+			menu->addChild(createMenuItem("Fast", mod->fastMath ? "•" : "", [=]() { mod->fastMath = true; }));
+			menu->addChild(createMenuItem("Accurate", !mod->fastMath ? "•" : "", [=]() { mod->fastMath = false; }));
+		}));
+
 		menu->addChild(rack::createSubmenuItem("Dephase Algorithm", "", [=](ui::Menu* menu) {
 			menu->addChild(createMenuItem("Old", mod->params[QuatOSC::DEPHASE].getValue() == 0.f ? "•" : "",[=]() { mod->params[QuatOSC::DEPHASE].setValue(0.f); }));
 			menu->addChild(createMenuItem("New", mod->params[QuatOSC::DEPHASE].getValue() == 1.f ? "•" : "", [=]() { mod->params[QuatOSC::DEPHASE].setValue(1.f); }));
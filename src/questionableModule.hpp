@@ -2,6 +2,7 @@
 
 #include "plugin.hpp"
 #include "colorBG.hpp"
+#include "ui.hpp"
 #include <string>
 #include <cctype>
 #include <iomanip>
@@ -10,6 +11,10 @@
 #include <vector>
 #include <mutex>
 #include <queue>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <chrono>
 
 // simple variable that has a dirty state
 // designed for native types
@@ -129,82 +134,456 @@ struct PolyphonicValue {
 
 };
 
-// Threadsafe queue that doesn't lock on read, only write
-template <typename T>
-struct ThreadQueue {
-	std::mutex mut;
-	std::queue<T> queue[2];
-	std::atomic<bool> activeQueue = false;
+// Bounded lock free queue, any thread can push, only one thread may pop.
+// Each slot carries a sequence number (Vyukov's bounded queue) so pushing is a single CAS
+// and popping never waits. Push fails instead of allocating when the queue is full, that only
+// happens when the consumer stops popping (engine paused or stalled) with SIZE pushes waiting.
+// Callers should recover where they can, refused pushes are counted so the ui can report them.
+template <typename T, size_t SIZE = 256>
+struct CommandQueue {
+	static_assert((SIZE & (SIZE - 1)) == 0, "CommandQueue size must be a power of 2");
+
+	struct Slot {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	Slot slots[SIZE];
+	std::atomic<size_t> pushPos {0};
+	size_t popPos = 0; // only touched by the consumer
+	std::atomic<size_t> dropped {0};
+
+	CommandQueue() {
+		for (size_t i = 0; i < SIZE; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool push(const T& value) {
+		size_t pos = pushPos.load(std::memory_order_relaxed);
+		Slot* slot;
+		while (true) {
+			slot = &slots[pos & (SIZE - 1)];
+			intptr_t diff = (intptr_t)slot->sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+			if (diff == 0) {
+				if (pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) { // full
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			else pos = pushPos.load(std::memory_order_relaxed);
+		}
+		slot->value = value;
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only
+	bool pop(T& value) {
+		Slot* slot = &slots[popPos & (SIZE - 1)];
+		if (slot->sequence.load(std::memory_order_acquire) != popPos + 1) return false; // empty
+		value = slot->value;
+		slot->sequence.store(popPos + SIZE, std::memory_order_release);
+		popPos++;
+		return true;
+	}
+
+	// pushes refused since the last call
+	size_t takeDropped() {
+		return dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+};
+
+// xoshiro128**, small and cheap enough to call from the audio thread
+// seeded once instead of hitting std::random_device on every call
+struct QuestionableRandom {
+	typedef uint32_t result_type;
+
+	uint32_t state[4];
+
+	QuestionableRandom() {
+		seed(std::random_device()());
+	}
+
+	QuestionableRandom(uint64_t s) {
+		seed(s);
+	}
 
-	void push(T& obj) {
-		std::lock_guard<std::mutex> guard(mut);
-		queue[!activeQueue] = queue[activeQueue];
-		queue[!activeQueue].push(obj);
-		activeQueue = !activeQueue;
+	// splitmix64 to spread the seed over the whole state
+	void seed(uint64_t s) {
+		for (int i = 0; i < 4; i++) {
+			s += 0x9E3779B97F4A7C15ull;
+			uint64_t z = s;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			state[i] = (uint32_t)((z ^ (z >> 31)) >> 32);
+		}
+	}
+
+	static inline uint32_t rotl(uint32_t x, int k) {
+		return (x << k) | (x >> (32 - k));
 	}
 
-	void pop() {
-		std::lock_guard<std::mutex> guard(mut);
-		queue[!activeQueue] = queue[activeQueue];
-		queue[!activeQueue].pop();
-		activeQueue = !activeQueue;
+	uint32_t next() {
+		uint32_t result = rotl(state[1] * 5, 7) * 9;
+		uint32_t t = state[1] << 9;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotl(state[3], 11);
+		return result;
 	}
 
-	// limited functionallity
-	T& front() { return queue[activeQueue].front(); }
-	T& back() { return queue[activeQueue].back(); }
-	bool empty() { return queue[activeQueue].empty(); }
-	size_t size() { return queue[activeQueue].size(); }
+	// [0, 1)
+	double uniform() {
+		return (next() >> 8) * (1.0 / 16777216.0);
+	}
 
+	// usable with std algorithms like std::shuffle
+	static constexpr uint32_t min() { return 0; }
+	static constexpr uint32_t max() { return UINT32_MAX; }
+	uint32_t operator()() { return next(); }
 };
 
+// for anything not owned by a module (ui, worker threads), one generator per thread
+inline QuestionableRandom& threadRandom() {
+	thread_local QuestionableRandom random;
+	return random;
+}
+
+enum RateInterpolation {
+	INTERPOLATE_LINEAR,
+	INTERPOLATE_CUBIC,
+	INTERPOLATIONS_LEN
+};
+
+static const std::string rateInterpolationNames[INTERPOLATIONS_LEN] = {"Linear", "Cubic"};
+
+// last few computed frames of one output, newest last
+struct RateHistory {
+	float points[4][PORT_MAX_CHANNELS] = {};
+};
+
+enum QualityTier {
+	QUALITY_FULL,
+	QUALITY_REDUCED,
+	QUALITY_LOW,
+	QUALITY_MINIMUM,
+	QUALITY_TIERS_LEN
+};
+
+static const std::string qualityTierNames[QUALITY_TIERS_LEN] = {"Full", "Reduced", "Low", "Minimum"};
+
+// measured audio thread load of every governed module together, in millionths of a core
+inline std::atomic<int>& pluginLoad() {
+	static std::atomic<int> load = {0};
+	return load;
+}
+
 struct QuestionableModule : Module {
 	bool supportsSampleRateOverride = false; 
 	bool supportsThemes = true;
 	bool toggleableDescriptors = true;
+	bool supportsRandomSeed = false;
+	bool supportsOversampling = false;
+	bool supportsQualityGovernor = false;
+
+	// only every rateDivider-th frame is computed, the outputs in between are interpolated
+	int rateDivider = 1;
+	int rateInterpolation = INTERPOLATE_LINEAR;
+	int activeRateDivider = 1;
+	int rateCounter = 0;
+	bool rateHistoryPrimed = false;
+	std::vector<RateHistory> rateHistory;
+
+	// outputs worth running for, a module that leaves this empty never idles
+	std::vector<int> idleOutputs;
+	// inputs that also idle the module once silent for IDLE_HOLD_TIME, for modules whose outputs are then silent too
+	std::vector<int> idleInputs;
+	const float IDLE_HOLD_TIME = 0.5f;
+	// awake, silence only has to be noticed within IDLE_HOLD_TIME so the inputs are scanned this often
+	static const int IDLE_CHECK_STRIDE = 32;
+	int idleCheckCounter = 0;
+	bool idle = false;
+	float silentTime = 0.f;
+
+	// Quality governor, steps down a tier while the plugin is over its budget and back up once there is
+	// plenty of headroom again. What a tier gives up is up to the module. Every module sees the same plugin
+	// load, so the wait before stepping scales with the module's own share of it: the heaviest steps down
+	// first and the load it sheds resets everyone else's wait, the lightest steps back up first.
+	static const int GOVERNOR_STRIDE = 17; // odd so the timed frames don't lock onto the rate divider
+	const float GOVERNOR_DEGRADE_TIME = 0.25f;
+	const float GOVERNOR_RESTORE_TIME = 2.f;
+	const float GOVERNOR_MIN_SHARE = 0.125f; // untimed or tiny modules still step down eventually
+	const float GOVERNOR_RESTORE_LOAD = 0.4f; // of the budget, a tier roughly halves the load so this doesn't bounce
+	bool adaptiveQuality = true;
+	std::atomic<int> qualityTier = {QUALITY_FULL};
+	int governorCounter = 0;
+	float governorLoad = 0.f;
+	int governorLoadPpm = 0;
+	float governorOver = 0.f;
+	float governorUnder = 0.f;
+	// so identical instances with identical shares don't all step on the same tick
+	float governorJitter = 1.f + 0.5f * (threadRandom().next() >> 8) / (float)(1 << 24);
+
+	// the module runs this many sub samples per sample itself and filters them back down
+	int oversample = 1;
+	bool showDescriptors = userSettings.snapshot().showDescriptors;
+	std::string theme = userSettings.snapshot().theme;
+
+	// audio thread random, only seeded by the user so renders can be repeated
+	QuestionableRandom rng;
+	bool useRandomSeed = false;
+	uint32_t randomSeed = 0;
+	// seed waiting for the audio thread to apply, -1 for none, so rng is never touched from the ui
+	std::atomic<int64_t> pendingSeed = {-1};
+
+	~QuestionableModule() {
+		pluginLoad().fetch_sub(governorLoadPpm, std::memory_order_relaxed);
+	}
 
-	float sampleRateOverride = 0;
-	bool runHalfRate = false;
-	int64_t frame = 0;
-	bool showDescriptors = userSettings.getSetting<bool>("showDescriptors");
-	std::string theme = userSettings.getSetting<std::string>("theme");
+	// the subclass has run config() by now, size the per output state here rather than on the audio thread
+	void onAdd(const AddEvent& e) override {
+		Module::onAdd(e);
+		rateHistory.resize(outputs.size());
+	}
+
+	void setRandomSeed(uint32_t seed) {
+		useRandomSeed = true;
+		randomSeed = seed;
+		pendingSeed.store(seed);
+	}
+
+	void clearRandomSeed() {
+		useRandomSeed = false;
+		pendingSeed.store(threadRandom().next());
+	}
+
+	// audio thread, call before anything draws from rng
+	void applyPendingSeed() {
+		if (pendingSeed.load(std::memory_order_relaxed) == -1) return;
+		int64_t seed = pendingSeed.exchange(-1);
+		if (seed != -1) rng.seed(seed);
+	}
 
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 		if (supportsThemes) json_object_set_new(rootJ, "theme", json_string(theme.c_str()));
 		if (toggleableDescriptors) json_object_set_new(rootJ, "showDescriptors", json_boolean(showDescriptors));
-		if (supportsSampleRateOverride) json_object_set_new(rootJ, "runHalfRate", json_boolean(runHalfRate));
+		if (supportsSampleRateOverride) {
+			json_object_set_new(rootJ, "rateDivider", json_integer(rateDivider));
+			json_object_set_new(rootJ, "rateInterpolation", json_integer(rateInterpolation));
+		}
+		if (supportsOversampling) json_object_set_new(rootJ, "oversample", json_integer(oversample));
+		if (supportsQualityGovernor) json_object_set_new(rootJ, "adaptiveQuality", json_boolean(adaptiveQuality));
+		if (supportsRandomSeed && useRandomSeed) json_object_set_new(rootJ, "randomSeed", json_integer(randomSeed));
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
 		if (supportsThemes) if (json_t* s = json_object_get(rootJ, "theme")) theme = json_string_value(s);
 		if (toggleableDescriptors) if (json_t* d = json_object_get(rootJ, "showDescriptors")) showDescriptors = json_boolean_value(d);
-		if (supportsSampleRateOverride) if (json_t* hr = json_object_get(rootJ, "runHalfRate")) runHalfRate = json_boolean_value(hr);
+		if (supportsSampleRateOverride) {
+			// older patches only had full or half
+			if (json_t* hr = json_object_get(rootJ, "runHalfRate")) rateDivider = json_boolean_value(hr) ? 2 : 1;
+			if (json_t* rd = json_object_get(rootJ, "rateDivider")) {
+				rateDivider = json_integer_value(rd);
+				if (rateDivider != 2 && rateDivider != 4 && rateDivider != 8 && rateDivider != 16) rateDivider = 1;
+			}
+			if (json_t* ri = json_object_get(rootJ, "rateInterpolation")) rateInterpolation = clamp((int)json_integer_value(ri), 0, INTERPOLATIONS_LEN - 1);
+		}
+		if (supportsOversampling) if (json_t* os = json_object_get(rootJ, "oversample")) {
+			oversample = json_integer_value(os);
+			if (oversample != 2 && oversample != 4 && oversample != 8) oversample = 1;
+		}
+		if (supportsQualityGovernor) if (json_t* aq = json_object_get(rootJ, "adaptiveQuality")) adaptiveQuality = json_boolean_value(aq);
+		if (supportsRandomSeed) if (json_t* rs = json_object_get(rootJ, "randomSeed")) setRandomSeed(json_integer_value(rs));
 	}
 
-	void onSampleRateChange(const SampleRateChangeEvent& e) override {
-		if (supportsSampleRateOverride && runHalfRate) sampleRateOverride = e.sampleRate / 2;
+	bool inputsSilent() {
+		for (int i : idleInputs) {
+			int channels = inputs[i].getChannels();
+			for (int c = 0; c < channels; c++) if (inputs[i].getVoltage(c) != 0.f) return false;
+		}
+		return true;
+	}
+
+	// call once per frame, true when nothing would hear the module's output this frame
+	bool updateIdle(const ProcessArgs& args) {
+		if (idleOutputs.empty()) return false;
+
+		bool wasIdle = idle;
+		bool patched = false;
+		for (int o : idleOutputs) if (outputs[o].isConnected()) {
+			patched = true;
+			break;
+		}
+
+		if (!patched) {
+			// nothing to hear, no need to look at the inputs
+			idle = true;
+			silentTime = 0.f;
+		} else if (!idleInputs.empty()) {
+			// asleep the inputs are scanned every frame so the first sound isn't missed, it stops at the first non zero voltage
+			if (idle || ++idleCheckCounter >= IDLE_CHECK_STRIDE) {
+				float elapsed = idle ? args.sampleTime : idleCheckCounter * args.sampleTime;
+				idleCheckCounter = 0;
+				silentTime = inputsSilent() ? std::min(silentTime + elapsed, IDLE_HOLD_TIME) : 0.f;
+			}
+			idle = silentTime >= IDLE_HOLD_TIME;
+		} else idle = false;
+
+		// interpolation history is stale after a nap
+		if (wasIdle && !idle) rateHistoryPrimed = false;
+		return idle;
+	}
+
+	bool governorTick() {
+		if (++governorCounter < GOVERNOR_STRIDE) return false;
+		governorCounter = 0;
+		return true;
+	}
+
+	// load is the fraction of the audio thread one frame of this module takes
+	void reportLoad(float load) {
+		governorLoad += (load - governorLoad) * 0.05f;
+		int ppm = (int)(governorLoad * 1e6f);
+		pluginLoad().fetch_add(ppm - governorLoadPpm, std::memory_order_relaxed);
+		governorLoadPpm = ppm;
+	}
+
+	void stepGovernor(float dt) {
+		if (!adaptiveQuality) {
+			qualityTier = QUALITY_FULL;
+			governorOver = governorUnder = 0.f;
+			return;
+		}
+
+		float budget = userSettings.snapshot().qualityBudget / 100.f;
+		float load = pluginLoad().load(std::memory_order_relaxed) / 1e6f;
+		int tier = qualityTier;
+		float share = load > 0.f ? std::min(governorLoad / load, 1.f) : 0.f;
+		if (load > budget && tier < QUALITY_TIERS_LEN - 1) {
+			governorUnder = 0.f;
+			governorOver += dt;
+			if (governorOver >= GOVERNOR_DEGRADE_TIME * governorJitter / std::max(share, GOVERNOR_MIN_SHARE)) {
+				qualityTier = tier + 1;
+				governorOver = 0.f;
+			}
+		} else if (load < budget * GOVERNOR_RESTORE_LOAD && tier > QUALITY_FULL) {
+			governorOver = 0.f;
+			governorUnder += dt;
+			if (governorUnder >= GOVERNOR_RESTORE_TIME * governorJitter * (1.f + 3.f * share)) {
+				qualityTier = tier - 1;
+				governorUnder = 0.f;
+			}
+		} else governorOver = governorUnder = 0.f;
+	}
+
+	// the governor can push the divider further than the user set it, one halving per tier
+	int effectiveRateDivider() {
+		if (!supportsSampleRateOverride) return 1;
+		if (!supportsQualityGovernor) return rateDivider;
+		return std::max(rateDivider, 1 << qualityTier);
 	}
 
 	void process(const ProcessArgs& args) override {
-		if (sampleRateOverride == 0) {
-			processUndersampled(args);
+		if (!supportsQualityGovernor || !governorTick()) {
+			processFrame(args);
 			return;
 		}
-		// only undersample logic for now
-		if (args.sampleRate == sampleRateOverride || args.frame % (int)(args.sampleRate/sampleRateOverride) == 0) {
+
+		// time one frame in GOVERNOR_STRIDE, cheap enough to leave on all the time
+		auto start = std::chrono::steady_clock::now();
+		processFrame(args);
+		std::chrono::duration<float> took = std::chrono::steady_clock::now() - start;
+		reportLoad(took.count() * args.sampleRate);
+		stepGovernor(args.sampleTime * GOVERNOR_STRIDE);
+	}
+
+	void processFrame(const ProcessArgs& args) {
+		applyPendingSeed();
+		updateIdle(args);
+
+		int divider = effectiveRateDivider();
+		if (divider != activeRateDivider) {
+			activeRateDivider = divider;
+			// stay lined up with the engine frame so the divided frame count keeps the same time base
+			rateCounter = args.frame % divider;
+			rateHistoryPrimed = false;
+			onRateDividerChange();
+		}
+
+		if (divider == 1) {
+			if (idle) processIdle(args);
+			else processUndersampled(args);
+			return;
+		}
+
+		// an empty history gets a frame right away rather than waiting for the next boundary
+		if (rateCounter == 0 || (!idle && !rateHistoryPrimed)) {
 			ProcessArgs newArgs;
-			newArgs.sampleTime = 1 / sampleRateOverride;
-			newArgs.sampleRate = sampleRateOverride;
-			newArgs.frame = frame++;
-			processUndersampled(newArgs);
+			newArgs.sampleTime = args.sampleTime * divider;
+			newArgs.sampleRate = args.sampleRate / divider;
+			newArgs.frame = args.frame / divider;
+			if (idle) processIdle(newArgs);
+			else {
+				processUndersampled(newArgs);
+				pushRateHistory();
+			}
+		}
+
+		if (!idle) interpolateOutputs((float)rateCounter / divider);
+		if (++rateCounter >= divider) rateCounter = 0;
+	}
+
+	// reads back what processUndersampled just wrote
+	void pushRateHistory() {
+		for (size_t i = 0; i < rateHistory.size(); i++) {
+			RateHistory& h = rateHistory[i];
+			int channels = outputs[i].getChannels();
+			for (int c = 0; c < channels; c++) {
+				float v = outputs[i].getVoltage(c);
+				if (rateHistoryPrimed) {
+					h.points[0][c] = h.points[1][c];
+					h.points[1][c] = h.points[2][c];
+					h.points[2][c] = h.points[3][c];
+					h.points[3][c] = v;
+				} else for (int p = 0; p < 4; p++) h.points[p][c] = v;
+			}
+		}
+		rateHistoryPrimed = true;
+	}
+
+	// linear runs one computed frame behind, cubic two so it can see a point either side
+	void interpolateOutputs(float t) {
+		for (size_t i = 0; i < rateHistory.size(); i++) {
+			RateHistory& h = rateHistory[i];
+			int channels = outputs[i].getChannels();
+			for (int c = 0; c < channels; c++) {
+				float v;
+				if (rateInterpolation == INTERPOLATE_CUBIC) {
+					// catmull-rom between points 1 and 2
+					float p0 = h.points[0][c], p1 = h.points[1][c], p2 = h.points[2][c], p3 = h.points[3][c];
+					v = p1 + 0.5f * t * (p2 - p0 + t * (2.f*p0 - 5.f*p1 + 4.f*p2 - p3 + t * (3.f*(p1 - p2) + p3 - p0)));
+				} else {
+					v = h.points[2][c] + (h.points[3][c] - h.points[2][c]) * t;
+				}
+				outputs[i].setVoltage(v, c);
+			}
 		}
 	}
 
 	// if the module needs to undersample it will use this instead and rely on parent to send process calls
 	virtual void processUndersampled(const ProcessArgs& args) {};
 
+	// runs instead of processUndersampled while idle, only has to keep the state that outlives a nap moving
+	virtual void processIdle(const ProcessArgs& args) {};
+
+	// the rate processUndersampled runs at just changed, by hand or by the governor
+	virtual void onRateDividerChange() {};
+
 };
 
 struct QuestionableThemed {
@@ -288,15 +667,60 @@ struct QuestionableWidget : QuestionableTimed<ModuleWidget> {
   	{
 		QuestionableModule* mod = (QuestionableModule*)module;
 
-		if (mod->supportsSampleRateOverride) menu->addChild(rack::createSubmenuItem("Sample Rate", "", [=](ui::Menu* menu) {
-			menu->addChild(createMenuItem("Full", mod->runHalfRate ? "" : "•",[=]() { 
-				mod->sampleRateOverride = 0; 
-				mod->runHalfRate = false; 
+		if (mod->supportsSampleRateOverride) menu->addChild(rack::createSubmenuItem("Sample Rate", mod->rateDivider == 1 ? "Full" : "1/" + std::to_string(mod->rateDivider), [=](ui::Menu* menu) {
+			menu->addChild(createMenuItem("Full", mod->rateDivider == 1 ? "•" : "", [=]() { 
+				mod->rateDivider = 1;
 			}));
-			menu->addChild(createMenuItem("Half", mod->runHalfRate ? "•" : "", [=]() { 
-				mod->sampleRateOverride = APP->engine->getSampleRate() / 2; 
-				mod->runHalfRate = true; 
+			for (int divider : {2, 4, 8, 16}) {
+				menu->addChild(createMenuItem("1/" + std::to_string(divider), mod->rateDivider == divider ? "•" : "", [=]() {
+					mod->rateDivider = divider;
+				}));
+			}
+			menu->addChild(new MenuSeparator);
+			menu->addChild(createMenuLabel("Interpolation"));
+			for (int i = 0; i < INTERPOLATIONS_LEN; i++) {
+				menu->addChild(createMenuItem(rateInterpolationNames[i], mod->rateInterpolation == i ? "•" : "", [=]() {
+					mod->rateInterpolation = i;
+				}));
+			}
+			if (mod->supportsOversampling) {
+				menu->addChild(new MenuSeparator);
+				menu->addChild(createMenuLabel("Oversampling"));
+				menu->addChild(createMenuItem("Off", mod->oversample == 1 ? "•" : "", [=]() {
+					mod->oversample = 1;
+				}));
+				for (int os : {2, 4, 8}) {
+					menu->addChild(createMenuItem(std::to_string(os) + "x", mod->oversample == os ? "•" : "", [=]() {
+						mod->oversample = os;
+					}));
+				}
+			}
+		}));
+
+		if (mod->supportsQualityGovernor) menu->addChild(rack::createSubmenuItem("Adaptive Quality", mod->adaptiveQuality ? qualityTierNames[mod->qualityTier] : "Off", [=](ui::Menu* menu) {
+			menu->addChild(createMenuItem(mod->adaptiveQuality ? "Disable" : "Enable", "", [=]() {
+				mod->adaptiveQuality = !mod->adaptiveQuality;
+			}));
+			menu->addChild(createMenuLabel("Tier: " + qualityTierNames[mod->qualityTier]));
+			menu->addChild(createMenuLabel(string::f("Plugin load: %.1f%%", pluginLoad().load() / 1e4f)));
+			menu->addChild(new MenuSeparator);
+			menu->addChild(createMenuLabel("Plugin Budget"));
+			int currentBudget = userSettings.snapshot().qualityBudget;
+			for (int budget : {10, 25, 50, 100}) {
+				menu->addChild(createMenuItem(std::to_string(budget) + "%", currentBudget == budget ? "•" : "", [=]() {
+					userSettings.setSetting<int>("qualityBudget", budget);
+				}));
+			}
+		}));
+
+		if (mod->supportsRandomSeed) menu->addChild(rack::createSubmenuItem("Random Seed", mod->useRandomSeed ? std::to_string(mod->randomSeed) : "Off", [=](ui::Menu* menu) {
+			menu->addChild(createMenuItem("Off", mod->useRandomSeed ? "" : "•", [=]() {
+				mod->clearRandomSeed();
 			}));
+			menu->addChild(rack::createMenuLabel("Seed:"));
+			menu->addChild(new QuestionableTextField([=](std::string text) {
+				if (text.size() && text.size() < 10 && std::all_of(text.begin(), text.end(), ::isdigit)) mod->setRandomSeed(std::stoul(text));
+			}, 100, mod->useRandomSeed ? std::to_string(mod->randomSeed) : "", true));
 		}));
 
 		if (supportsThemes) {
@@ -549,19 +973,26 @@ T clamp(T min, T max, T value) {
 	return std::min(max, std::max(min, value));
 }
 
+template <typename T>
+T randomReal(QuestionableRandom& random, T min = 0.0, T max = 1.0) {
+	return min + (max - min) * (T)random.uniform();
+}
+
 template <typename T>
 T randomReal(T min = 0.0, T max = 1.0) {
-	std::uniform_real_distribution<T> distribution(0, max);
-	std::random_device rd;
-	return distribution(rd);
+	return randomReal<T>(threadRandom(), min, max);
+}
+
+// inclusive range
+template <typename T>
+T randomInt(QuestionableRandom& random, T min, T max) {
+	uint64_t range = (uint64_t)((int64_t)max - (int64_t)min) + 1;
+	return (T)((int64_t)min + (int64_t)(((uint64_t)random.next() * range) >> 32));
 }
 
 template <typename T>
 T randomInt(T min, T max) {
-	std::random_device rd; // obtain a random number from hardware
-	std::mt19937 gen(rd()); // seed the generator
-	std::uniform_int_distribution<T> distr(min, max); // define the range
-	return distr(gen);
+	return randomInt<T>(threadRandom(), min, max);
 }
 
 // Deg to Rad
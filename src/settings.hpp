@@ -7,7 +7,12 @@ using namespace rack;
 #include <fstream>
 #include <stdexcept>
 #include <mutex>
+#include <atomic>
+#include <vector>
 #include <memory>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 
 // https://stackoverflow.com/questions/17032310/how-to-make-a-variadic-is-same
 template <class T, class... Ts>
@@ -18,6 +23,31 @@ struct QuestionableJsonable {
 	virtual void fromJson(json_t*) = 0;
 };
 
+// Typed copy of the settings modules read while constructing, so loading a big patch doesn't line up on
+// the settings lock. Rebuilt and swapped in whenever one of its keys is written.
+struct SettingsSnapshot {
+	std::string theme = "";
+	bool showDescriptors = true;
+	int treequencerScreenColor = 0;
+	int treequencerHistoryLimit = 100000;
+	int qualityBudget = 25;
+
+	static constexpr const char* KEYS[] = {"theme", "showDescriptors", "treequencerScreenColor", "treequencerHistoryLimit", "qualityBudget"};
+
+	static bool hasKey(const std::string& key) {
+		for (const char* k : KEYS) if (key == k) return true;
+		return false;
+	}
+
+	void fromJson(json_t* json) {
+		if (json_t* t = json_object_get(json, "theme")) if (json_string_value(t)) theme = json_string_value(t);
+		if (json_t* d = json_object_get(json, "showDescriptors")) showDescriptors = json_boolean_value(d);
+		if (json_t* c = json_object_get(json, "treequencerScreenColor")) treequencerScreenColor = json_integer_value(c);
+		if (json_t* h = json_object_get(json, "treequencerHistoryLimit")) treequencerHistoryLimit = json_integer_value(h);
+		if (json_t* b = json_object_get(json, "qualityBudget")) qualityBudget = json_integer_value(b);
+	}
+};
+
 // Global module settings
 struct UserSettings {
 	std::mutex lock;
@@ -29,6 +59,18 @@ struct UserSettings {
 	std::string settingFileName;
 	json_t* settingCache = nullptr;
 
+	// Changes only touch settingCache, a background thread writes the file once they settle down
+	const std::chrono::milliseconds SAVE_DEBOUNCE = std::chrono::milliseconds(500);
+	std::thread saveThread;
+	std::condition_variable saveCondition;
+	std::chrono::steady_clock::time_point lastChange;
+	bool saveQueued = false;
+	bool stopSaving = false;
+
+	// readers only ever load the pointer, old snapshots are kept since someone may still be reading one
+	std::atomic<const SettingsSnapshot*> currentSnapshot = {nullptr};
+	std::vector<std::unique_ptr<SettingsSnapshot>> snapshots;
+
 	std::function<json_t*(json_t*)> initFunction = nullptr;
 	const std::function<json_t*(json_t*)>* migrations = nullptr;
 
@@ -43,8 +85,33 @@ struct UserSettings {
 			UserSettings::json_create_if_not_exists(json, "settingsVersion", json_integer(settingsVersion));
 			if (migrations) json = runMigrations(json, migrations);
 			json = initFunction(json);
+			settingCache = json;
 			saveSettings(json);
 		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		publishSnapshot(readSettings());
+	}
+
+	// lock free, for reading settings while modules are being made and every frame
+	const SettingsSnapshot& snapshot() {
+		return *currentSnapshot.load(std::memory_order_acquire);
+	}
+
+	~UserSettings() {
+		flush();
+	}
+
+	// write anything still waiting and stop the save thread
+	void flush() {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (!saveThread.joinable()) return;
+			stopSaving = true;
+		}
+		saveCondition.notify_one();
+		saveThread.join();
+		stopSaving = false;
 	}
 
 	static void json_create_if_not_exists(json_t* json, std::string name, json_t* value) {
@@ -91,7 +158,8 @@ struct UserSettings {
 		if (v) {
 			json_t* settings = readSettings();
 			json_object_set(settings, setting.c_str(), v);
-			saveSettings(settings);
+			if (SettingsSnapshot::hasKey(setting)) publishSnapshot(settings);
+			queueSave();
 
 			return;
 		}
@@ -132,7 +200,7 @@ struct UserSettings {
 		}
 
 		json_object_set(settings, setting.c_str(), array);
-		saveSettings(settings);
+		queueSave();
 	}
 
 
@@ -163,7 +231,8 @@ struct UserSettings {
 			std::string settingsFilename = asset::user(settingFileName);
 			FILE *file = fopen(settingsFilename.c_str(), "r");
 			if (!file) {
-				return json_object();
+				settingCache = json_object();
+				return settingCache;
 			}
 				
 			json_error_t error;
@@ -172,7 +241,8 @@ struct UserSettings {
 			fclose(file);
 				
 			if (!rootJ) {
-				return json_object();
+				settingCache = json_object();
+				return settingCache;
 			}
 
 			settingCache = rootJ;
@@ -181,15 +251,65 @@ struct UserSettings {
 		} else return settingCache;
 	}
 
+	// needs the lock held
+	void publishSnapshot(json_t* settings) {
+		std::unique_ptr<SettingsSnapshot> snap(new SettingsSnapshot());
+		snap->fromJson(settings);
+		currentSnapshot.store(snap.get(), std::memory_order_release);
+		snapshots.push_back(std::move(snap));
+	}
+
+	// needs the lock held
+	void queueSave() {
+		saveQueued = true;
+		lastChange = std::chrono::steady_clock::now();
+		if (!saveThread.joinable()) saveThread = std::thread(&UserSettings::saveWorker, this);
+		saveCondition.notify_one();
+	}
+
+	void saveWorker() {
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			saveCondition.wait(guard, [this]() { return saveQueued || stopSaving; });
+			if (!saveQueued) return;
+
+			// wait for a burst of changes (typing, dragging) to finish before writing
+			while (!stopSaving && std::chrono::steady_clock::now() < lastChange + SAVE_DEBOUNCE) {
+				saveCondition.wait_until(guard, lastChange + SAVE_DEBOUNCE);
+			}
+
+			char* text = json_dumps(settingCache, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
+			saveQueued = false;
+
+			guard.unlock();
+			if (text) {
+				writeSettings(text);
+				free(text);
+			}
+			guard.lock();
+		}
+	}
+
 	void saveSettings(json_t *rootJ) {
+		char* text = json_dumps(rootJ, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
+		if (!text) return;
+		writeSettings(text);
+		free(text);
+	}
+
+	// write next to the real file and swap it in so a crash mid write can't leave it truncated
+	void writeSettings(const char* text) {
 		std::string settingsFilename = asset::user(settingFileName);
-		
-		FILE *file = fopen(settingsFilename.c_str(), "w");
-		
-		if (file) {
-			json_dumpf(rootJ, file, JSON_INDENT(2) | JSON_REAL_PRECISION(9));
-			fclose(file);
-		}
+		std::string tempFilename = settingsFilename + ".tmp";
+
+		FILE *file = fopen(tempFilename.c_str(), "w");
+		if (!file) return;
+
+		bool written = fputs(text, file) >= 0;
+		written = fclose(file) == 0 && written;
+
+		if (written) system::rename(tempFilename, settingsFilename);
+		else system::remove(tempFilename);
 	}
 	
 };
\ No newline at end of file
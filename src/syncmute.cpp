@@ -107,7 +107,9 @@ struct SyncMute : QuestionableModule {
 		RIGHT
 	};
 
-	ThreadQueue<ExpanderMessage> expanderMessages;
+	// filled by neighbours' process() calls and drained by ours every sample, so the 256 slots only run out
+	// if this module stops processing, whatever doesn't fit is dropped and reported by the widget
+	CommandQueue<ExpanderMessage> expanderMessages;
 	bool expanderRight = false;
 	bool expanderLeft = false;
 
@@ -139,8 +141,8 @@ struct SyncMute : QuestionableModule {
 	}
 
 	void processMessages() {
-		while (!expanderMessages.empty()) {
-			ExpanderMessage msg = expanderMessages.front();
+		ExpanderMessage msg;
+		while (expanderMessages.pop(msg)) {
 			if (msg.type == MessageType::ONRESET) onReset();
 			if (msg.type == MessageType::ONBUTTON) mutes[msg.buttonId].shouldSwap = !mutes[msg.buttonId].shouldSwap;
 			if (msg.type == MessageType::ONBUTTONAUTO) mutes[msg.buttonId].autoPress = msg.autoPress;
@@ -152,7 +154,6 @@ struct SyncMute : QuestionableModule {
 					subClockTime = 0.f;
 				}
 			}
-			expanderMessages.pop();
 		}
 	}
 
@@ -190,6 +191,7 @@ struct SyncMute : QuestionableModule {
 
 	SyncMute() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		supportsRandomSeed = true;
 		configSwitch(MUTE, 0.f, 1.f, 0.f, "Mute Toggle");
 		configSwitch(MUTE2, 0.f, 1.f, 0.f, "Mute Toggle");
 		configSwitch(MUTE3, 0.f, 1.f, 0.f, "Mute Toggle");
@@ -228,6 +230,8 @@ struct SyncMute : QuestionableModule {
 		for (size_t i = 0; i < 8; i++) {
 			mutes[i].module = this;
 			mutes[i].paramId = i;
+			idleOutputs.push_back(OUT+i);
+			idleInputs.push_back(IN+i);
 		}
 
 		onReset();
@@ -295,7 +299,7 @@ struct SyncMute : QuestionableModule {
 				muteState = !muteState;
 				shouldSwap = false;
 				// if range specified, randomly offset ratio
-				if (ratioRangeLeft || ratioRangeRight) signatureOffset = randomInt(-(int)ratioRangeLeft, (int)ratioRangeRight);
+				if (ratioRangeLeft || ratioRangeRight) signatureOffset = randomInt(module->rng, -(int)ratioRangeLeft, (int)ratioRangeRight);
 				else signatureOffset = 0;
 			}
 
@@ -351,6 +355,8 @@ struct SyncMute : QuestionableModule {
 	}
 
 	void process(const ProcessArgs& args) override {
+		applyPendingSeed();
+		updateIdle(args);
 		processMessages();
 		resetClocksThisTick = resetTrigger.process(inputs[RESET].getVoltage(), 0.1f, 2.f);
 		isClockInputConnected = inputs[CLOCK].isConnected();
@@ -393,11 +399,13 @@ struct SyncMute : QuestionableModule {
 
 		subClockTime += args.sampleTime; // this must be after step to fix clock never getting hit with multiply ratio
 		
-		// outputs
-		for (size_t i = 0; i < 8; i++) {
-			PolyphonicValue input(inputs[IN+i]);
-			input *= mutes[i].volume;
-			input.setOutput(outputs[OUT+i]);
+		// outputs, clocks and mutes above keep running while idle
+		if (!idle) {
+			for (size_t i = 0; i < 8; i++) {
+				PolyphonicValue input(inputs[IN+i]);
+				input *= mutes[i].volume;
+				input.setOutput(outputs[OUT+i]);
+			}
 		}
 
 	}
@@ -668,6 +676,12 @@ struct MuteButton : Resizable<QuestionableTimed<QuestionableParam<CKD6>>> {
 
 struct SyncMuteWidget : QuestionableWidget {
 	//ColorBGSimple* bgSimple;
+
+	void step() override {
+		if (module) if (size_t dropped = ((SyncMute*)module)->expanderMessages.takeDropped()) WARN("SyncMute expander queue full, %zu messages dropped", dropped);
+		QuestionableWidget::step();
+	}
+
 	void setText() {
 		NVGcolor c = nvgRGB(255,255,255);
 		color->textList.clear();
@@ -13,6 +13,10 @@
 #include <queue>
 #include <algorithm>
 #include <utility>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <limits>
 
 const int MAX_OUTPUTS = 8;
 const int MODULE_SIZE = 22;
@@ -200,180 +204,380 @@ static Scale getScale(std::string scaleName) {
 	return getScale("Minor Pentatonic");
 }
 
-// A node in the tree
-struct Node {
-  	int output = 0;
-	bool enabled = false;
-	float chance = 0.5;
-	Node* parent;
-	int depth = 0;
-  	std::vector<Node*> children;
+typedef uint32_t NodeId;
 
-	Rect box;
+// atomic that can be copied along with the rest of a tree
+struct NodeStamp {
+	std::atomic<uint32_t> value {0};
 
-	Node(Node* p = nullptr, int out = randomInt<int>(-1, 7), float c = randomReal<float>(0, 0.9f)) {
-		output = out;
-		chance = c;
-		parent = p;
-		if (parent) depth = parent->depth + 1;
+	NodeStamp() { }
+	NodeStamp(const NodeStamp& other) : value(other.value.load(std::memory_order_relaxed)) { }
+	NodeStamp& operator=(const NodeStamp& other) {
+		value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
 	}
+};
+const NodeId NO_NODE = std::numeric_limits<NodeId>::max();
+// Layout no longer needs the cap, the display does: a node at depth d is 2^-d of the root's size and following
+// it zooms by as much, past this float screen coordinates can't place nodes apart anymore.
+// Patches with deeper trees keep their nodes, sequences just stop walking at this depth.
+const int MAX_NODE_DEPTH = 21;
+
+// The tree of nodes, stored as flat arrays and addressed by index.
+// Removed nodes are kept on a free list for reuse, copying or freeing a whole tree is just its arrays.
+struct NodeTree {
+	std::vector<int> output;
+	std::vector<float> chance;
+	std::vector<NodeId> parent; // NO_NODE for the root and for removed nodes
+	std::vector<std::array<NodeId, 2>> children; // packed to the front
+	std::vector<uint8_t> childCount;
+	std::vector<uint16_t> depth;
+	std::vector<NodeStamp> sequenceStamp; // sequence generation this node was last part of, written by the audio thread
+	std::vector<NodeId> freeNodes;
+
+	NodeId root = NO_NODE;
+	uint64_t version = 0; // set when published so the display can tell which edits it has laid out
+	NodeTree* nextRetired = nullptr; // links swapped out trees waiting to be freed, see Treequencer::retireTree
+
+	size_t size() {
+		return output.size() - freeNodes.size();
+	}
+
+	bool isValid(NodeId node) {
+		return node < output.size() && (node == root || parent[node] != NO_NODE);
+	}
+
+	void clear() {
+		output.clear();
+		chance.clear();
+		parent.clear();
+		children.clear();
+		childCount.clear();
+		depth.clear();
+		sequenceStamp.clear();
+		freeNodes.clear();
+		root = NO_NODE;
+	}
+
+	NodeId createNode(NodeId p, int out, float c) {
+		NodeId node;
+		if (freeNodes.size()) {
+			node = freeNodes.back();
+			freeNodes.pop_back();
+		} else {
+			node = output.size();
+			output.push_back(0);
+			chance.push_back(0.f);
+			parent.push_back(NO_NODE);
+			children.push_back({NO_NODE, NO_NODE});
+			childCount.push_back(0);
+			depth.push_back(0);
+			sequenceStamp.push_back(NodeStamp());
+		}
 
-	Node(json_t* json, Node* p=nullptr) {
-		parent = p;
-		if (parent) depth = parent->depth + 1;
-		fromJson(json);
-	}
+		output[node] = out;
+		chance[node] = c;
+		parent[node] = p;
+		children[node] = {NO_NODE, NO_NODE};
+		childCount[node] = 0;
+		depth[node] = p == NO_NODE ? 0 : depth[p] + 1;
+		sequenceStamp[node].value.store(0, std::memory_order_relaxed);
+		if (p != NO_NODE) children[p][childCount[p]++] = node;
 
-	~Node() {
-		for (size_t i = 0; i < children.size(); i++) delete children[i];
+		return node;
 	}
 
-	void setOutput(int out) {
-		
-		output = out;
+	// resets the tree to a single node
+	NodeId createRoot(int out = randomInt<int>(-1, 7), float c = randomReal<float>(0, 0.9f)) {
+		clear();
+		root = createNode(NO_NODE, out, c);
+		return root;
 	}
 
-	void setChance(float ch) {
-		
-		chance = std::min(0.9f, std::max(0.1f, ch)); 
+	NodeId addChild(NodeId node, int out = randomInt<int>(-1, 7), float c = randomReal<float>(0, 0.9f)) {
+		if (childCount[node] > 1) return NO_NODE;
+		return createNode(node, out, c);
 	}
 
-	void setenabled(bool en) {
-		
-		enabled = en;
-	}
+	// detach a node from its parent and free it with everything below it
+	void remove(NodeId node) {
+		NodeId p = parent[node];
+		if (p == NO_NODE) return;
 
-	int getOutput() { 
-		
-		return output; 
-	}
+		if (children[p][0] == node) children[p][0] = children[p][1];
+		children[p][1] = NO_NODE;
+		childCount[p]--;
 
-	float getChance() {
-		
-		return chance; 
+		// the free list doubles as the queue for walking the removed nodes
+		size_t start = freeNodes.size();
+		freeNodes.push_back(node);
+		for (size_t i = start; i < freeNodes.size(); i++) {
+			NodeId n = freeNodes[i];
+			for (int c = 0; c < childCount[n]; c++) freeNodes.push_back(children[n][c]);
+			parent[n] = NO_NODE;
+			childCount[n] = 0;
+		}
 	}
 
-	bool getEnabled() {
-		
-		return enabled; 
+	void setChance(NodeId node, float ch) {
+		chance[node] = std::min(0.9f, std::max(0.1f, ch));
 	}
 
-	std::vector<Node*> getChildren() {
-		
-		return children;
-	}
-
-	std::vector<int> getHistory() {
-		if (!parent) return {output};
-		std::vector history = parent->getHistory();
-		history.push_back(output);
+	std::vector<int> getHistory(NodeId node) {
+		std::vector<int> history;
+		for (NodeId n = node; n != NO_NODE; n = parent[n]) history.push_back(output[n]);
+		std::reverse(history.begin(), history.end());
 		return history;
 	}
 
-	// Fill each Node with 2 other nodes until depth is met
-	// assumes EMPTY
-  	void fillToDepth(int desiredDepth) {
-		if (desiredDepth <= 0) return;
-
-		Node* child1 = new Node(this);
-		Node* child2 = new Node(this);
-		child1->fillToDepth(desiredDepth-1);
-		child2->fillToDepth(desiredDepth-1);
-
-		children.push_back(child1);
-		children.push_back(child2);
-  	}
-
-	Node* addChild(int out = randomInt<int>(-1, 7), float c = randomReal<float>(0, 0.9f)) {
-		if (children.size() > 1) return nullptr;
+	// child slots leading from the root to this node
+	std::vector<int> getPath(NodeId node) {
+		std::vector<int> path;
+		for (NodeId n = node; parent[n] != NO_NODE; n = parent[n]) path.push_back(getSlot(n));
+		std::reverse(path.begin(), path.end());
+		return path;
+	}
 
-		Node* child = new Node(this);
-		child->parent = this;
-		child->chance = c;
-		child->output = out;
-		children.push_back(child);
+	NodeId findFromPath(std::vector<int> path) {
+		NodeId node = root;
+		for (size_t i = 0; i < path.size(); i++) {
+			if (path[i] >= childCount[node]) return NO_NODE;
+			node = children[node][path[i]];
+		}
+		return node;
+	}
 
-		return child;
+	// which of its parents child slots a node is in
+	int getSlot(NodeId node) {
+		return children[parent[node]][0] == node ? 0 : 1;
+	}
 
+	size_t subtreeSize(NodeId node) {
+		size_t count = 1;
+		for (int i = 0; i < childCount[node]; i++) count += subtreeSize(children[node][i]);
+		return count;
 	}
 
-	void remove() {
-		if (!parent) return;
-		parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
-		delete this;
+	int maxDepth(NodeId node) {
+		int deepest = 0;
+		for (int i = 0; i < childCount[node]; i++) deepest = std::max(deepest, maxDepth(children[node][i]) + 1);
+		return deepest;
 	}
 
-	int maxDepth() {
-		if (children.size() == 0) return 0;
+	// Fill each Node with 2 other nodes until depth is met
+	// assumes EMPTY
+	void fillToDepth(NodeId node, int desiredDepth) {
+		if (desiredDepth <= 0) return;
 
-		std::vector<int> sizes;
-		for (size_t i = 0; i < children.size(); i++) {
-			sizes.push_back(children[i]->maxDepth() + 1);
-		}
-		return *std::max_element(sizes.begin(), sizes.end());
+		NodeId child1 = addChild(node);
+		NodeId child2 = addChild(node);
+		if (child1 != NO_NODE) fillToDepth(child1, desiredDepth-1);
+		if (child2 != NO_NODE) fillToDepth(child2, desiredDepth-1);
 	}
 
-	void generateSequencesToDepth(Scale s, int d, std::vector<int> history=std::vector<int>()) {
-		if (history.empty()) history = getHistory();
+	void generateSequencesToDepth(NodeId node, Scale s, int d, std::vector<int> history=std::vector<int>()) {
+		if (history.empty()) history = getHistory(node);
 		if (d <= 0) return;
-		if (depth >= 21) return;
-		
+		if (depth[node] >= MAX_NODE_DEPTH) return;
 
 		if (randomReal<float>() > 0.9) return;
 
-		if (Node* child1 = addChild()) {
+		NodeId child1 = addChild(node);
+		if (child1 != NO_NODE) {
 			std::vector<int> c1History = history;
-			child1->output = s.getNextInSequence(history, 48);
-			c1History.push_back(child1->output);
-			child1->generateSequencesToDepth(s, d-1, c1History);
+			output[child1] = s.getNextInSequence(history, 48);
+			c1History.push_back(output[child1]);
+			generateSequencesToDepth(child1, s, d-1, c1History);
 		}
 
 		if (randomReal<float>() > 0.9) return;
-		
-		if (Node* child2 = addChild()) {
+
+		NodeId child2 = addChild(node);
+		if (child2 != NO_NODE) {
 			std::vector<int> c2History = history;
-			child2->output = s.getNextInSequence(history, 48);
-			c2History.push_back(child2->output);
-			child2->generateSequencesToDepth(s, d-1, c2History);
+			output[child2] = s.getNextInSequence(history, 48);
+			c2History.push_back(output[child2]);
+			generateSequencesToDepth(child2, s, d-1, c2History);
 		}
 	}
 
-	json_t* toJson() {
+	json_t* toJson(NodeId node) {
 		json_t* nodeJ = json_object();
 
-		json_object_set_new(nodeJ, "output", json_integer(output));
-		json_object_set_new(nodeJ, "chance", json_real(chance));
-		
+		json_object_set_new(nodeJ, "output", json_integer(output[node]));
+		json_object_set_new(nodeJ, "chance", json_real(chance[node]));
+
 		json_t *childrenArray = json_array();
 		json_object_set_new(nodeJ, "children", childrenArray);
 
-		for (size_t i = 0; i < children.size(); i++) {
-			json_array_append_new(childrenArray, children[i]->toJson());
+		for (int i = 0; i < childCount[node]; i++) {
+			json_array_append_new(childrenArray, toJson(children[node][i]));
 		}
 
 		return nodeJ;
 	}
 
-	void fromJson(json_t* json) {
+	json_t* toJson() {
+		return toJson(root);
+	}
 
-		if (json_t* out = json_object_get(json, "output")) output = json_integer_value(out);
-		if (json_t* c = json_object_get(json, "chance")) chance = json_real_value(c);
+	NodeId nodeFromJson(json_t* json, NodeId p) {
+		int out = 0;
+		float c = 0.5;
+		if (json_t* o = json_object_get(json, "output")) out = json_integer_value(o);
+		if (json_t* ch = json_object_get(json, "chance")) c = json_real_value(ch);
 
-		if (json_t* arr = json_object_get(json, "children")) {
+		NodeId node = createNode(p, out, c);
 
-			for (size_t i = 0; i < json_array_size(arr); i++) {
-				children.push_back(new Node(json_array_get(arr, i), this));
+		if (json_t* arr = json_object_get(json, "children")) {
+			for (size_t i = 0; i < std::min((size_t)2, json_array_size(arr)); i++) {
+				nodeFromJson(json_array_get(arr, i), node);
 			}
-
 		}
 
+		return node;
+	}
+
+	// load a subtree from json as a child of p, placed in the given child slot
+	NodeId insertFromJson(NodeId p, int slot, json_t* json) {
+		if (childCount[p] > 1) return NO_NODE;
+		NodeId node = nodeFromJson(json, p);
+		if (slot == 0 && childCount[p] > 1) std::swap(children[p][0], children[p][1]);
+		return node;
+	}
+
+	// resets the tree and loads it from json
+	void fromJson(json_t* json) {
+		clear();
+		root = nodeFromJson(json, NO_NODE);
+
+		int deepest = 0;
+		for (size_t i = 0; i < depth.size(); i++) if (isValid(i)) deepest = std::max(deepest, (int)depth[i]);
+		if (deepest > MAX_NODE_DEPTH) WARN("Treequencer tree is %d deep, sequences only play its first %d levels", deepest, MAX_NODE_DEPTH);
 	}
 
 };
 
-/*for (const auto& child : node->children) {
-	
-}*/
+// Something the ui wants done to the live tree, applied by process()
+struct TreeCommand {
+	enum Type {
+		SET_OUTPUT,
+		SET_CHANCE,
+		PREVIEW,
+		SET_PREROLL
+	};
+
+	Type type;
+	NodeId node = NO_NODE;
+	float value = 0.f;
+	uint64_t version = 0; // of the editTree a value edit was made on
+};
+
+// A root to leaf walk through the tree, fixed size so building one never allocates on the audio thread.
+struct SequencePath {
+	std::array<NodeId, MAX_NODE_DEPTH+1> nodes;
+	int length = 0;
+
+	size_t size() { return length; }
+	bool empty() { return length == 0; }
+	void clear() { length = 0; }
+	NodeId operator[](size_t i) { return nodes[i]; }
+
+	// false once full, loaded patches can hold trees deeper than MAX_NODE_DEPTH
+	bool push_back(NodeId node) {
+		if (length >= (int)nodes.size()) return false;
+		nodes[length++] = node;
+		return true;
+	}
+};
+
+// A single undoable change, nodes are addressed by their path from the root so edits survive tree copies.
+struct TreeEdit {
+	enum Type {
+		SET_OUTPUT,
+		SET_CHANCE,
+		ADD_SUBTREE,
+		REMOVE_SUBTREE
+	};
+
+	Type type;
+	std::vector<int> path; // to the node for SET_*, to the parent for *_SUBTREE
+	int slot = 0;
+	float before = 0.f;
+	float after = 0.f;
+	json_t* subtree = nullptr;
+
+	bool isStructural() {
+		return type == ADD_SUBTREE || type == REMOVE_SUBTREE;
+	}
+
+	static TreeEdit forValue(Type type, NodeTree* t, NodeId node, float before, float after) {
+		TreeEdit e;
+		e.type = type;
+		e.path = t->getPath(node);
+		e.before = before;
+		e.after = after;
+		return e;
+	}
+
+	// call after adding or before removing the subtree
+	static TreeEdit forSubtree(Type type, NodeTree* t, NodeId node) {
+		TreeEdit e;
+		e.type = type;
+		e.path = t->getPath(t->parent[node]);
+		e.slot = t->getSlot(node);
+		e.subtree = t->toJson(node);
+		return e;
+	}
+
+	void apply(NodeTree* t, bool undo) {
+		NodeId node = t->findFromPath(path);
+		if (node == NO_NODE) return;
+
+		switch (type) {
+			case SET_OUTPUT:
+				t->output[node] = undo ? before : after;
+				break;
+			case SET_CHANCE:
+				t->chance[node] = undo ? before : after;
+				break;
+			case ADD_SUBTREE:
+			case REMOVE_SUBTREE:
+				if ((type == ADD_SUBTREE) != undo) t->insertFromJson(node, slot, subtree);
+				else if (slot < t->childCount[node]) t->remove(t->children[node][slot]);
+				break;
+		}
+	}
+};
+
+// one undo step, cost is roughly the number of nodes it holds on to
+struct HistoryEntry {
+	std::vector<TreeEdit> edits;
+	size_t cost = 0;
+	uint64_t session = 0; // node menu that made it, 0 for none
+
+	void add(TreeEdit e) {
+		cost += 1 + (e.subtree ? countNodes(e.subtree) : 0);
+		edits.push_back(e);
+	}
+
+	bool isStructural() {
+		for (size_t i = 0; i < edits.size(); i++) if (edits[i].isStructural()) return true;
+		return false;
+	}
+
+	void free() {
+		for (size_t i = 0; i < edits.size(); i++) if (edits[i].subtree) json_decref(edits[i].subtree);
+		edits.clear();
+	}
+
+	static size_t countNodes(json_t* json) {
+		size_t count = 1;
+		json_t* arr = json_object_get(json, "children");
+		for (size_t i = 0; i < json_array_size(arr); i++) count += countNodes(json_array_get(arr, i));
+		return count;
+	}
+};
 
 struct Treequencer : QuestionableModule {
 	enum ParamId {
@@ -416,13 +620,13 @@ struct Treequencer : QuestionableModule {
 		LIGHTS_LEN
 	};
 
-	ThreadQueue<std::function<void()>> audioThreadQueue;
+	CommandQueue<TreeCommand> commandQueue;
 
 	// json data for screen
 	float startScreenScale = 12.9f;
 	float startOffsetX = 12.5f;
 	float startOffsetY = -11.f;
-	int colorMode = userSettings.getSetting<int>("treequencerScreenColor");
+	int colorMode = userSettings.snapshot().treequencerScreenColor;
 	int noteRepresentation = 2;
 	bool followNodes = false;
 	std::string defaultScale = "Minor Pentatonic"; // scale for new node gen
@@ -440,58 +644,344 @@ struct Treequencer : QuestionableModule {
 	dsp::PulseGenerator sequencePulse;
 	float timeSinceReset = 0.f;
 
-	Node rootNode;
-	Node* activeNode;
-	std::vector<Node*> activeSequence;
-	size_t historyPos = 0;
-	std::vector<json_t*> history;
-	bool historyDirty = true;
+	// the tree process() walks, only ever swapped by process() itself. The display loads it once per frame,
+	// process() is its only writer so reads its own tree through liveTree().
+	std::atomic<NodeTree*> tree {new NodeTree()};
+	NodeId activeNode = 0;
+	SequencePath activeSequence;
+	SequencePath nextSequence; // rolled ahead of time when prerollSequences is on
+	bool prerollSequences = false;
+	// The display checks sequence membership with tree->sequenceStamp[node] == sequenceGeneration
+	// instead of reading activeSequence, which only the audio thread may touch.
+	std::atomic<uint32_t> sequenceGeneration {1};
+	size_t historyPos = 0; // entries before this are applied
+	uint64_t editSessions = 0; // counts node menus opened, see pushHistory
+	std::vector<HistoryEntry> history;
+	size_t historyCost = 0;
+	size_t historyLimit = userSettings.snapshot().treequencerHistoryLimit;
+
+	// Edits never touch the tree process() is walking. editTree is the ui's own copy of the newest tree,
+	// every edit lands there first and the menus read it. Structural edits then hand process() a copy of it
+	// through pendingTree, the tree it replaces goes on the retiredTrees list to be freed off the audio thread.
+	// Value edits reach process() through the command queue, stamped with the editTree version they were made on.
+	// editMutex guards editTree and the history and is never taken on the audio thread.
+	std::mutex editMutex;
+	NodeTree* editTree = nullptr;
+	std::atomic<NodeTree*> pendingTree {nullptr};
+	std::atomic<NodeTree*> retiredTrees {nullptr}; // linked through NodeTree::nextRetired
+	std::atomic<NodeTree*> displayedTree {nullptr}; // what the display is drawing, never freed while it is
+	TreeCommand deferredCommand; // made on a tree that wasn't swapped in yet when it was popped
+	bool hasDeferredCommand = false;
+
+	// sequence generation runs on its own thread
+	std::thread generateThread;
+	std::atomic<bool> generating {false};
+
+	// false when the queue is full, see CommandQueue
+	bool onAudioThread(TreeCommand command) {
+		return commandQueue.push(command);
+	}
+
+	bool onAudioThread(TreeCommand::Type type, NodeId node, float value = 0.f) {
+		TreeCommand command;
+		command.type = type;
+		command.node = node;
+		command.value = value;
+		return onAudioThread(command);
+	}
+
+	// Subtrees whose layout changed, tagged with the version of the tree that changed them.
+	// NO_NODE means the whole tree, entries are consumed by the display. editMutex guards both.
+	uint64_t treeVersion = 0;
+	std::vector<std::pair<uint64_t, NodeId>> layoutChanges;
+
+	void logLayoutChange(NodeTree* t, NodeId changed) {
+		if (layoutChanges.size() > 1000) { // nobody is drawing, relayout everything when they do
+			layoutChanges.clear();
+			changed = NO_NODE;
+		}
+		layoutChanges.push_back({t->version, changed});
+	}
+
+	// editMutex must be held, entry is what was applied to editTree, nullptr if anything could have changed
+	void publishTree(HistoryEntry* entry = nullptr) {
+		editTree->version = ++treeVersion;
+		if (!entry) logLayoutChange(editTree, NO_NODE);
+		else for (size_t i = 0; i < entry->edits.size(); i++) {
+			if (entry->edits[i].isStructural()) logLayoutChange(editTree, editTree->findFromPath(entry->edits[i].path));
+		}
+
+		NodeTree* t = new NodeTree(*editTree);
+		if (NodeTree* unused = pendingTree.exchange(t)) delete unused; // never picked up by process()
+		reclaimRetiredTrees(); // so trees don't pile up while nothing is drawing
+	}
+
+	// run the edit on editTree and publish a copy
+	void editStructure(std::function<void(NodeTree*, HistoryEntry&)> edit) {
+		std::lock_guard<std::mutex> guard(editMutex);
+		HistoryEntry entry;
+		edit(editTree, entry);
+		if (entry.edits.empty()) return;
+		publishTree(&entry);
+		pushHistory(entry);
+	}
+
+	// editMutex must be held
+	void applyValueEdit(TreeCommand::Type type, NodeId node, float value) {
+		if (!editTree->isValid(node)) return;
+		if (type == TreeCommand::SET_OUTPUT) editTree->output[node] = value;
+		else editTree->chance[node] = value;
+
+		TreeCommand command;
+		command.type = type;
+		command.node = node;
+		command.value = value;
+		command.version = editTree->version;
+		// queue full, the value is already in editTree so hand process() a copy of that instead
+		if (!onAudioThread(command)) publishTree();
+	}
+
+	void setNodeValue(TreeCommand::Type type, NodeId node, float value) {
+		std::lock_guard<std::mutex> guard(editMutex);
+		applyValueEdit(type, node, value);
+	}
+
+	void addChildTo(NodeId node, Scale scale) {
+		editStructure([=](NodeTree* t, HistoryEntry& entry) mutable {
+			if (!t->isValid(node)) return;
+			NodeId child = t->addChild(node, scale.getNextInSequence(t->getHistory(node)));
+			if (child != NO_NODE) entry.add(TreeEdit::forSubtree(TreeEdit::ADD_SUBTREE, t, child));
+		});
+	}
+
+	void removeNode(NodeId node) {
+		editStructure([=](NodeTree* t, HistoryEntry& entry) {
+			if (!t->isValid(node) || node == t->root) return;
+			entry.add(TreeEdit::forSubtree(TreeEdit::REMOVE_SUBTREE, t, node));
+			t->remove(node);
+		});
+	}
+
+	void generateSequenceAsync(NodeId node, Scale scale, int depth = 8) {
+		if (generating.exchange(true)) return; // one at a time
+		if (generateThread.joinable()) generateThread.join();
+
+		NodeTree* t;
+		{
+			std::lock_guard<std::mutex> guard(editMutex);
+			t = new NodeTree(*editTree);
+		}
+
+		// generate on a scratch copy and replay the result onto editTree, so edits made meanwhile stay
+		generateThread = std::thread([=]() {
+			HistoryEntry entry;
+			if (t->isValid(node)) {
+				int existing = t->childCount[node];
+				t->generateSequencesToDepth(node, scale, depth);
+				for (int i = existing; i < t->childCount[node]; i++) entry.add(TreeEdit::forSubtree(TreeEdit::ADD_SUBTREE, t, t->children[node][i]));
+			}
+			delete t;
+
+			std::lock_guard<std::mutex> guard(editMutex);
+			for (size_t i = 0; i < entry.edits.size(); i++) entry.edits[i].apply(editTree, false);
+			if (entry.edits.size()) {
+				publishTree(&entry);
+				pushHistory(entry);
+			}
+			generating = false;
+		});
+	}
+
+	NodeTree* liveTree() {
+		return tree.load(std::memory_order_relaxed);
+	}
+
+	// swap in a tree published by the editing side
+	void processPendingTree() {
+		NodeTree* t = pendingTree.exchange(nullptr);
+		if (!t) return;
+
+		NodeTree* old = tree.exchange(t);
+
+		// keep playing from the same place unless that part of the tree is gone
+		if (!t->isValid(activeNode)) resetActiveNode();
+		for (size_t i = 0; i < activeSequence.size(); i++) {
+			if (!t->isValid(activeSequence[i])) {
+				activeSequence.clear();
+				break;
+			}
+		}
+		nextSequence.clear(); // may have walked through a part that changed
+		stampSequence(); // the new tree may have been copied before the current sequence was stamped
+		isDirty = true;
 
-	void onAudioThread(std::function<void()> func) {
-		audioThreadQueue.push(func);
+		retireTree(old);
+	}
+
+	// lock free, so process() can hand back the tree it swapped out
+	void retireTree(NodeTree* t) {
+		NodeTree* head = retiredTrees.load();
+		do t->nextRetired = head;
+		while (!retiredTrees.compare_exchange_weak(head, t));
+	}
+
+	// free the swapped out trees, apart from the one the display is drawing. Any thread but the audio thread.
+	void reclaimRetiredTrees() {
+		NodeTree* t = retiredTrees.exchange(nullptr);
+		NodeTree* shown = displayedTree.load(); // read after taking the list, see acquireDisplayedTree
+		while (t) {
+			NodeTree* next = t->nextRetired;
+			if (t == shown) retireTree(t);
+			else delete t;
+			t = next;
+		}
+	}
+
+	// the tree for the display to draw until it asks again. Rechecked after marking it, once marked a tree
+	// that gets retired is still seen as shown by any reclaim that could have taken it off the list.
+	NodeTree* acquireDisplayedTree() {
+		NodeTree* t;
+		do {
+			t = tree.load();
+			displayedTree.store(t);
+		} while (tree.load() != t);
+		return t;
 	}
 
 	void processOffThreadQueue() {
-		while (!audioThreadQueue.empty()) {
-			audioThreadQueue.front()();
-			audioThreadQueue.pop();
+		// value edits may have been made on the tree that's waiting, drain once it's swapped in
+		if (pendingTree.load()) return;
+
+		NodeTree* t = liveTree();
+
+		TreeCommand command;
+		while (hasDeferredCommand || commandQueue.pop(command)) {
+			if (hasDeferredCommand) {
+				command = deferredCommand;
+				hasDeferredCommand = false;
+			}
+
+			if (command.type == TreeCommand::SET_PREROLL) {
+				prerollSequences = command.value;
+				continue;
+			}
+
+			if (command.type == TreeCommand::SET_OUTPUT || command.type == TreeCommand::SET_CHANCE) {
+				// published after the check above, hold on to it until that tree is playing
+				if (command.version > t->version) {
+					deferredCommand = command;
+					hasDeferredCommand = true;
+					return;
+				}
+				// copied from editTree after the edit, so it's already in there
+				if (command.version < t->version) continue;
+			}
+			if (!t->isValid(command.node)) continue;
+
+			switch (command.type) {
+				case TreeCommand::SET_OUTPUT:
+					t->output[command.node] = command.value;
+					isDirty = true;
+					break;
+				case TreeCommand::SET_CHANCE:
+					t->chance[command.node] = command.value;
+					isDirty = true;
+					break;
+				case TreeCommand::PREVIEW:
+					activeNode = command.node;
+					params[HOLD].setValue(1.f);
+					break;
+				default:
+					break;
+			}
 		}
 	}
 
+	// editMutex must be held for the history functions
 	void clearHistory() {
+		for (size_t i = 0; i < history.size(); i++) history[i].free();
 		history.clear();
 		historyPos = 0;
+		historyCost = 0;
 	}
 
-	void pushHistory(json_t* state = nullptr) {
-		if (historyPos != history.size()) history.erase(history.begin() + historyPos, history.end());
-		history.push_back(state ? state : rootNode.toJson());
+	// a value edit from the same menu session as the last entry folds into it when it changed the same thing,
+	// edits made at different times stay separate undo steps
+	void pushHistory(HistoryEntry entry) {
+		for (size_t i = historyPos; i < history.size(); i++) {
+			historyCost -= history[i].cost;
+			history[i].free();
+		}
+		history.erase(history.begin() + historyPos, history.end());
+
+		if (entry.session && history.size() && history.back().session == entry.session && entry.edits.size() == 1 && history.back().edits.size() == 1) {
+			TreeEdit& last = history.back().edits[0];
+			if (last.type == entry.edits[0].type && last.path == entry.edits[0].path) {
+				last.after = entry.edits[0].after;
+				return;
+			}
+		}
+
+		history.push_back(entry);
+		historyCost += entry.cost;
 		historyPos = history.size();
+		trimHistory();
+	}
+
+	// drop the oldest undo steps once over the limit, then redo steps from the far end, always keep the newest undo
+	void trimHistory() {
+		size_t dropped = 0;
+		while (historyCost > historyLimit && dropped + 1 < historyPos) {
+			historyCost -= history[dropped].cost;
+			history[dropped].free();
+			dropped++;
+		}
+		history.erase(history.begin(), history.begin() + dropped);
+		historyPos -= dropped;
+
+		while (historyCost > historyLimit && history.size() > historyPos) {
+			historyCost -= history.back().cost;
+			history.back().free();
+			history.pop_back();
+		}
+	}
+
+	// same paths as the edits themselves, value only steps are queued and anything structural is published
+	void applyHistory(HistoryEntry entry, bool undo) {
+		if (!entry.isStructural()) {
+			for (size_t i = 0; i < entry.edits.size(); i++) {
+				TreeEdit& e = entry.edits[undo ? entry.edits.size()-1-i : i];
+				NodeId node = editTree->findFromPath(e.path);
+				if (node == NO_NODE) continue;
+				applyValueEdit(e.type == TreeEdit::SET_OUTPUT ? TreeCommand::SET_OUTPUT : TreeCommand::SET_CHANCE, node, undo ? e.before : e.after);
+			}
+			return;
+		}
+
+		for (size_t i = 0; i < entry.edits.size(); i++) entry.edits[undo ? entry.edits.size()-1-i : i].apply(editTree, undo);
+		publishTree(&entry);
 	}
 
 	void historyGoBack() {
-		if (history.empty()) return;
-		if (historyPos == 1) return;
-		historyPos = clamp(historyPos-1, 1, history.size());
-		setRootNodeFromJson(history[historyPos-1]);
+		std::lock_guard<std::mutex> guard(editMutex);
+		if (generating) return;
+		if (historyPos == 0) return;
+		historyPos--;
+		applyHistory(history[historyPos], true);
 	}
 
 	void historyGoForward() {
+		std::lock_guard<std::mutex> guard(editMutex);
+		if (generating) return;
 		if (historyPos >= history.size()) return;
-		historyPos = clamp(historyPos+1, 1, history.size());
-		setRootNodeFromJson(history[historyPos-1]);
-	}
-
-	// resets the root and loads a tree from json
-	void setRootNodeFromJson(json_t* json) {
-		rootNode.children.clear();
-		activeNode = &rootNode;
-		rootNode.fromJson(json);
-		isDirty = true;
+		applyHistory(history[historyPos], false);
+		historyPos++;
 	}
 
 	Treequencer() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		supportsRandomSeed = true;
+		supportsQualityGovernor = true;
 		configInput(GATE_IN_1, "Gate");
 		configInput(CLOCK, "Clock");
 		configInput(RESET, "Reset");
@@ -515,68 +1005,98 @@ struct Treequencer : QuestionableModule {
 
 		configOutput(ALL_OUT, "VOct");
 		
-		rootNode.fillToDepth(1);
-		
-		rootNode.enabled = true;
-		activeNode = &rootNode;
+		NodeTree* t = liveTree();
+		t->createRoot();
+		t->fillToDepth(t->root, 1);
+		editTree = new NodeTree(*t);
+
+		activeNode = t->root;
 
-		pushHistory();
 		onReset();
 	}
 
+	~Treequencer() {
+		if (generateThread.joinable()) generateThread.join();
+		delete pendingTree.exchange(nullptr);
+		displayedTree.store(nullptr); // the display is gone
+		reclaimRetiredTrees();
+		delete tree.load();
+		delete editTree;
+		clearHistory();
+	}
+
 	float fclamp(float min, float max, float value) {
 		return std::min(min, std::max(max, value));
 	}
 
 	void resetActiveNode() {
-		activeNode->enabled = false;
-		activeNode = &rootNode;
-		activeNode->enabled = true;
-	}
-
-	std::vector<Node*> getWholeSequence(Node* node, std::vector<Node*> sequence = std::vector<Node*>()) {
-		sequence.push_back(node);
-		if (node->children.size() > 1) {
-			float r = randomReal<float>();
-			float chance = std::min(1.f, std::max(0.0f, node->chance - getChanceMod()));
-			Node* foundNode = node->children[r < chance ? 0 : 1];
-			return getWholeSequence(foundNode, sequence);
-		} else if(node->children.size()) {
-			Node* foundNode = node->children[0];
-			return getWholeSequence(foundNode, sequence);
-		} else {
-			return sequence;
+		activeNode = liveTree()->root;
+	}
+
+	// walk from the root to a leaf, or MAX_NODE_DEPTH levels down, picking children by chance
+	void walkSequence(SequencePath& path) {
+		NodeTree* t = liveTree();
+		path.clear();
+		NodeId node = t->root;
+		while (path.push_back(node)) {
+			if (t->childCount[node] > 1) {
+				float r = randomReal<float>(rng);
+				float chance = std::min(1.f, std::max(0.0f, t->chance[node] - getChanceMod()));
+				node = t->children[node][r < chance ? 0 : 1];
+			} else if (t->childCount[node]) {
+				node = t->children[node][0];
+			} else break;
 		}
 	}
 
+	// start a new activeSequence, when pre-rolling the walk for the one after happens now
+	// so the next sequence starts with a copy instead of a walk
+	void rollSequence() {
+		if (prerollSequences && nextSequence.size()) activeSequence = nextSequence;
+		else walkSequence(activeSequence);
+
+		if (prerollSequences) walkSequence(nextSequence);
+		else nextSequence.clear();
+
+		stampSequence();
+	}
+
+	// mark the nodes of activeSequence with a new generation and publish it
+	void stampSequence() {
+		uint32_t generation = sequenceGeneration.load(std::memory_order_relaxed) + 1;
+		for (size_t i = 0; i < activeSequence.size(); i++) liveTree()->sequenceStamp[activeSequence[i]].value.store(generation, std::memory_order_relaxed);
+		sequenceGeneration.store(generation, std::memory_order_release);
+	}
+
 	float getChanceMod() {
 		return params[CHANCE_MOD].getValue() + inputs[CHANCE_MOD_INPUT].getVoltage();
 	}
 
 	void processGateStep() {
+		NodeTree* t = liveTree();
 		if (!bouncing) {
-			if (!activeNode->children.size()) {
+			if (!t->childCount[activeNode]) {
 				if (params[BOUNCE].getValue()) {
 					bouncing = true;
-					if (activeNode->parent) activeNode = activeNode->parent;
+					if (t->parent[activeNode] != NO_NODE) activeNode = t->parent[activeNode];
 				}
-				else activeNode = &rootNode;
+				else activeNode = t->root;
 				sequencePulse.trigger(1e-3f); // signal sequence completed
 			}
 			else {
-				if (activeNode->children.size() > 1) {
-					float r = randomReal<float>();
-					float chance = std::min(1.f, std::max(0.0f, activeNode->chance - getChanceMod()));
-					activeNode = activeNode->children[r < chance ? 0 : 1];
+				if (t->childCount[activeNode] > 1) {
+					float r = randomReal<float>(rng);
+					float chance = std::min(1.f, std::max(0.0f, t->chance[activeNode] - getChanceMod()));
+					activeNode = t->children[activeNode][r < chance ? 0 : 1];
 				} else {
-					activeNode = activeNode->children[0];
+					activeNode = t->children[activeNode][0];
 				}
 			}
 		} else {
-			if (activeNode->parent) activeNode = activeNode->parent;
+			if (t->parent[activeNode] != NO_NODE) activeNode = t->parent[activeNode];
 			else {
 				bouncing = false;
-				if (activeNode->children.size()) processGateStep();
+				if (t->childCount[activeNode]) processGateStep();
 			}
 		}
 	}
@@ -585,12 +1105,11 @@ struct Treequencer : QuestionableModule {
 	void processSequence(bool newSequence = false) {
 		bool lastBounce = bouncing;
 		if (newSequence) {
-			activeSequence = getWholeSequence(&rootNode);
-			activeNode = &rootNode;
+			rollSequence();
+			activeNode = liveTree()->root;
 			sequencePos = 0;
 		} else {
 			if (!activeSequence.size()) processSequence(true);
-			activeNode->enabled = false;
 			sequencePos += bouncing ? -1 : 1;
 			if (sequencePos <= 0) {
 				if (bouncing) sequencePulse.trigger(1e-3f); // signal sequence completed
@@ -604,7 +1123,6 @@ struct Treequencer : QuestionableModule {
 				if (!bouncing) sequencePulse.trigger(1e-3f); // signal sequence completed
 			}
 			activeNode = activeSequence[sequencePos];
-			activeNode->enabled = true;
 		}
 
 		if (!lastBounce && (lastBounce != bouncing)) processSequence();
@@ -619,7 +1137,11 @@ struct Treequencer : QuestionableModule {
 	}
 
 	void process(const ProcessArgs& args) override {
+		applyPendingSeed();
+		// nothing to time here, the display just follows the plugin wide tier
+		if (governorTick()) stepGovernor(args.sampleTime * GOVERNOR_STRIDE);
 
+		processPendingTree();
 		processOffThreadQueue();
 		
 		bool canClock = timeSinceReset >= clockIgnoreTime;
@@ -649,23 +1171,24 @@ struct Treequencer : QuestionableModule {
 			isClockTriggered = false;
 		}
 
-		if (!seqTrigger && activeSequence.size()) activeSequence.clear();
-		else if (seqTrigger && activeSequence.empty()) activeSequence = getWholeSequence(&rootNode);
+		if (!seqTrigger && activeSequence.size()) {
+			activeSequence.clear();
+			stampSequence();
+		}
+		else if (seqTrigger && activeSequence.empty()) {
+			rollSequence();
+		}
 
 		if (!seqTrigger) isGateTriggered = isGateTriggered || isClockTriggered;
 
-		if (isGateTriggered && activeNode) {
-			activeNode->enabled = false;
-
+		if (isGateTriggered) {
 			if (params[TRIGGER_TYPE].getValue()) processSequence(true);
 			else processGateStep();
 
-			activeNode->enabled = true;
 			pulse.trigger(1e-3f);
 		}
 		if (isClockTriggered && seqTrigger) {
 			processSequence();
-			activeNode->enabled = true;
 			pulse.trigger(1e-3f);
 		}
 
@@ -674,9 +1197,9 @@ struct Treequencer : QuestionableModule {
 
 		outputs[SEQUENCE_COMPLETE].setVoltage(sequenceP ? 10.f : 0.0f);
 
-
-		if (activeNode->output < 8 && activeNode->output >= 0) outputs[activeNode->output].setVoltage(activeP ? 10.f : 0.0f);
-		outputs[ALL_OUT].setVoltage((float)activeNode->output/12);
+		int output = liveTree()->output[activeNode];
+		if (output < 8 && output >= 0) outputs[output].setVoltage(activeP ? 10.f : 0.0f);
+		outputs[ALL_OUT].setVoltage((float)output/12);
 
 	}
 
@@ -688,8 +1211,13 @@ struct Treequencer : QuestionableModule {
 		json_object_set_new(rootJ, "colorMode", json_integer(colorMode));
 		json_object_set_new(rootJ, "noteRepresentation", json_integer(noteRepresentation));
 		json_object_set_new(rootJ, "followNodes", json_boolean(followNodes));
+		json_object_set_new(rootJ, "prerollSequences", json_boolean(prerollSequences));
 		json_object_set_new(rootJ, "defaultScale", json_string(defaultScale.c_str()));
-		json_object_set_new(rootJ, "rootNode", rootNode.toJson());
+		{
+			// the newest tree, process() may still be waiting on some of its edits
+			std::lock_guard<std::mutex> guard(editMutex);
+			json_object_set_new(rootJ, "rootNode", editTree->toJson());
+		}
 
 		return rootJ;
 	}
@@ -703,6 +1231,7 @@ struct Treequencer : QuestionableModule {
 		if (json_t* sy = json_object_get(rootJ, "startOffsetY")) startOffsetY = json_real_value(sy);
 		if (json_t* cbm = json_object_get(rootJ, "colorMode")) colorMode = json_integer_value(cbm);
 		if (json_t* fn = json_object_get(rootJ, "followNodes")) followNodes = json_boolean_value(fn);
+		if (json_t* ps = json_object_get(rootJ, "prerollSequences")) prerollSequences = json_boolean_value(ps);
 		if (json_t* ds = json_object_get(rootJ, "defaultScale")) defaultScale = json_string_value(ds);
 
 		if (json_t* nr = json_object_get(rootJ, "noteRepresentation")) noteRepresentation = json_integer_value(nr);
@@ -710,11 +1239,29 @@ struct Treequencer : QuestionableModule {
 
 		if (json_t* s = json_object_get(rootJ, "theme")) theme = json_string_value(s);
 
-		if (json_t* rn = json_object_get(rootJ, "rootNode")) setRootNodeFromJson(rn);
+		if (generateThread.joinable()) generateThread.join();
+		std::lock_guard<std::mutex> guard(editMutex);
+
+		// the engine isn't running process() while we load so the tree can be replaced directly
+		if (json_t* rn = json_object_get(rootJ, "rootNode")) {
+			NodeTree* t = new NodeTree();
+			t->fromJson(rn);
+			delete pendingTree.exchange(nullptr);
+			retireTree(tree.exchange(t)); // the display may still be drawing it
+			reclaimRetiredTrees();
+			t->version = ++treeVersion;
+			delete editTree;
+			editTree = new NodeTree(*t);
+			hasDeferredCommand = false;
+			logLayoutChange(t, NO_NODE);
+			activeSequence.clear();
+			nextSequence.clear();
+			stampSequence();
+			resetActiveNode();
+			isDirty = true;
+		}
 
 		clearHistory();
-		pushHistory();
-		historyDirty = false;
 
 	}
 
@@ -832,7 +1379,7 @@ struct TreequencerHistoryButton : TreequencerButton {
 
 	void step() override {
 		if (!module) return;
-		disabled = isBack ? module->history.size() == 0 || module->historyPos <= 1 : module->historyPos >= module->history.size();
+		disabled = module->generating || (isBack ? module->historyPos == 0 : module->historyPos >= module->history.size());
 	}
 	
 	void onButton(const ButtonEvent& e) override {
@@ -870,6 +1417,78 @@ struct TreequencerFollowButton : TreequencerButton {
 
 };
 
+// Spatial index over the node rects so the display only visits what is on screen.
+// Rects that straddle a split stay in the parent quad.
+struct NodeQuadTree {
+	static const int MAX_ITEMS = 8;
+	static const int MAX_LEVEL = 12;
+
+	Rect bounds;
+	int level = 0;
+	std::vector<std::pair<Rect, NodeId>> items;
+	NodeQuadTree* quads[4] = {nullptr, nullptr, nullptr, nullptr};
+
+	NodeQuadTree(Rect bounds, int level = 0) {
+		this->bounds = bounds;
+		this->level = level;
+	}
+
+	~NodeQuadTree() {
+		clear();
+	}
+
+	void clear(Rect newBounds) {
+		clear();
+		bounds = newBounds;
+	}
+
+	void clear() {
+		items.clear();
+		for (int i = 0; i < 4; i++) {
+			delete quads[i];
+			quads[i] = nullptr;
+		}
+	}
+
+	void split() {
+		Vec half = bounds.size.div(2);
+		for (int i = 0; i < 4; i++) {
+			quads[i] = new NodeQuadTree(Rect(bounds.pos.plus(Vec(half.x * (i%2), half.y * (i/2))), half), level+1);
+		}
+
+		std::vector<std::pair<Rect, NodeId>> kept;
+		for (size_t i = 0; i < items.size(); i++) {
+			NodeQuadTree* quad = quadFor(items[i].first);
+			if (quad) quad->insert(items[i].first, items[i].second);
+			else kept.push_back(items[i]);
+		}
+		items = kept;
+	}
+
+	// the child quad fully containing the rect, if any
+	NodeQuadTree* quadFor(Rect r) {
+		if (!quads[0]) return nullptr;
+		for (int i = 0; i < 4; i++) if (quads[i]->bounds.contains(r)) return quads[i];
+		return nullptr;
+	}
+
+	void insert(Rect r, NodeId node) {
+		if (NodeQuadTree* quad = quadFor(r)) {
+			quad->insert(r, node);
+			return;
+		}
+
+		items.push_back({r, node});
+		if (!quads[0] && (int)items.size() > MAX_ITEMS && level < MAX_LEVEL) split();
+	}
+
+	void query(Rect area, std::vector<NodeId>& found) {
+		if (!bounds.intersects(area)) return;
+		for (size_t i = 0; i < items.size(); i++) if (items[i].first.intersects(area)) found.push_back(items[i].second);
+		if (quads[0]) for (int i = 0; i < 4; i++) quads[i]->query(area, found);
+	}
+};
+
 struct NodeDisplay : Widget {
 	Treequencer* module;
 
@@ -891,10 +1510,71 @@ struct NodeDisplay : Widget {
 
 	bool dirtyRender = true;
 
-	Node* lastActive = nullptr;
+	NodeId lastActive = NO_NODE;
+
+	// loaded once per frame in step(), the module won't free it until the next one
+	NodeTree* frameTree = nullptr;
+
+	// The tree itself is drawn into a framebuffer that is only redrawn when the tree or the view changes,
+	// the active node and the current sequence are drawn over it every frame.
+	struct StaticLayer : Widget {
+		NodeDisplay* display;
+
+		void draw(const DrawArgs &args) override {
+			if (!display->module || !display->frameTree) return;
+			nvgSave(args.vg);
+			nvgScissor(args.vg, 0, 0, box.size.x, box.size.y);
+			nvgScale(args.vg, display->screenScale, display->screenScale);
+			display->drawStaticNodes(args.vg);
+			nvgRestore(args.vg);
+		}
+	};
+
+	FramebufferWidget* staticFramebuffer;
+	StaticLayer* staticLayer;
+
+	// what the framebuffer was last drawn with
+	struct StaticState {
+		float xOffset = 0;
+		float yOffset = 0;
+		float screenScale = 0;
+		int colorMode = -1;
+		int noteRepresentation = -1;
+		bool sequenceMode = false;
+		int chanceMod = 0;
+
+		bool operator!=(const StaticState& other) {
+			return xOffset != other.xOffset || yOffset != other.yOffset || screenScale != other.screenScale || colorMode != other.colorMode ||
+				noteRepresentation != other.noteRepresentation || sequenceMode != other.sequenceMode || chanceMod != other.chanceMod;
+		}
+	};
+	StaticState staticState;
+	int shownChanceMod = 0;
+	int chanceRefresh = 0;
 
 	NodeDisplay() {
+		staticFramebuffer = new FramebufferWidget();
+		staticFramebuffer->oversample = 1.0;
+		staticFramebuffer->dirtyOnSubpixelChange = false;
+		addChild(staticFramebuffer);
 
+		staticLayer = new StaticLayer();
+		staticLayer->display = this;
+		staticFramebuffer->addChild(staticLayer);
+	}
+
+	void step() override {
+		if (module) {
+			frameTree = module->acquireDisplayedTree();
+			module->reclaimRetiredTrees();
+		}
+		if (module) if (size_t dropped = module->commandQueue.takeDropped()) WARN("Treequencer command queue full, %zu commands not queued", dropped);
+		if (!staticFramebuffer->box.size.equals(box.size)) {
+			staticFramebuffer->box.size = box.size;
+			staticLayer->box.size = box.size;
+			staticFramebuffer->setDirty();
+		}
+		Widget::step();
 	}
 
 	void resetScreenPosition() {
@@ -936,90 +1616,110 @@ struct NodeDisplay : Widget {
 		return true;
 	}
 
-	void createContextMenuForNode(Node* node) {
-		if (!node) return;
+	void createContextMenuForNode(NodeId node) {
+		if (node == NO_NODE) return;
 
 		Treequencer* mod = module;
 
 		auto menu = rack::createMenu<QuestionableMenu>();
 
-		int oldNodeOutput = node->output;
-		float oldNodeChance = node->chance;
+		// node belongs to a tree that is about to be swapped out
+		if (mod->generating) {
+			menu->addChild(rack::createMenuLabel("Generating..."));
+			return;
+		}
+
+		// read from editTree, the edits made here land there before process() sees them
+		int oldNodeOutput;
+		float oldNodeChance;
+		bool canAddChild;
+		bool isRoot;
+		uint64_t session;
+		{
+			std::lock_guard<std::mutex> guard(mod->editMutex);
+			session = ++mod->editSessions;
+			NodeTree* t = mod->editTree;
+			if (!t->isValid(node)) return;
+			oldNodeOutput = t->output[node];
+			oldNodeChance = t->chance[node];
+			canAddChild = t->childCount[node] < 2 && t->depth[node] < MAX_NODE_DEPTH;
+			isRoot = node == t->root;
+		}
 		menu->onDestruct = [=](){
-			if (oldNodeOutput != node->output) mod->pushHistory();
-			if (oldNodeChance != node->chance) mod->pushHistory();
+			std::lock_guard<std::mutex> guard(mod->editMutex);
+			NodeTree* t = mod->editTree;
+			if (!t->isValid(node)) return;
+			if (oldNodeOutput != t->output[node]) {
+				HistoryEntry entry;
+				entry.session = session;
+				entry.add(TreeEdit::forValue(TreeEdit::SET_OUTPUT, t, node, oldNodeOutput, t->output[node]));
+				mod->pushHistory(entry);
+			}
+			if (oldNodeChance != t->chance[node]) {
+				HistoryEntry entry;
+				entry.session = session;
+				entry.add(TreeEdit::forValue(TreeEdit::SET_CHANCE, t, node, oldNodeChance, t->chance[node]));
+				mod->pushHistory(entry);
+			}
 		};
 
 		menu->addChild(rack::createMenuLabel("Node Output:"));
 
 		ui::TextField* outparam = new QuestionableTextField([=](std::string text) {
-			if (text.length() < 4 && isInteger(text)) mod->onAudioThread([=](){ node->setOutput(std::stoi(text)-1); });
+			if (text.length() < 4 && isInteger(text)) mod->setNodeValue(TreeCommand::SET_OUTPUT, node, std::stoi(text)-1);
 		});
 		outparam->box.size.x = 100;
-		outparam->text = std::to_string(node->output + 1);
+		outparam->text = std::to_string(oldNodeOutput + 1);
 		menu->addChild(outparam);
 
 		menu->addChild(rack::createMenuLabel("Node Chance:"));
 
 		NodeChanceSlider* param = new NodeChanceSlider(
-			[=]() { return node->getChance(); }, 
-			[=](float value) { mod->onAudioThread([=](){ node->setChance(value);}); }
+			[=]() {
+				std::lock_guard<std::mutex> guard(mod->editMutex);
+				return mod->editTree->isValid(node) ? mod->editTree->chance[node] : 0.f;
+			},
+			[=](float value) { mod->setNodeValue(TreeCommand::SET_CHANCE, node, std::min(0.9f, std::max(0.1f, value))); }
 		);
 		menu->addChild(param);
 
 		menu->addChild(createMenuItem("Preview", "", [=]() { 
-			mod->onAudioThread([=](){
-				node->enabled = true;
-				mod->activeNode->enabled = false;
-				mod->activeNode = node;
-				mod->params[Treequencer::HOLD].setValue(1.f);
-			});
+			mod->onAudioThread(TreeCommand::PREVIEW, node);
 		}));
 
-		if (node->children.size() < 2 && node->depth < 21) menu->addChild(createMenuItem("Add Child", "", [=]() { 
-			mod->onAudioThread([=](){
-				node->addChild(getScale(mod->defaultScale).getNextInSequence(node->getHistory())); 
-				mod->pushHistory();
-				renderStateDirty();
-			});
+		if (canAddChild) menu->addChild(createMenuItem("Add Child", "", [=]() { 
+			mod->addChildTo(node, getScale(mod->defaultScale));
 		}));
 
-		if (node != &module->rootNode) menu->addChild(createMenuItem("Remove", "", [=]() {
-			mod->onAudioThread([=](){
-				mod->resetActiveNode();
-				node->remove();
-				mod->pushHistory();
-				renderStateDirty();
-			});
+		if (!isRoot) menu->addChild(createMenuItem("Remove", "", [=]() {
+			mod->removeNode(node);
 		}));
 
 		menu->addChild(rack::createSubmenuItem("Generate Sequence", "", [=](ui::Menu* menu) {
 			std::vector<Scale> scales = getScalesSorted();
 			for (size_t i = 0; i < scales.size(); i++) {
 				menu->addChild(createMenuItem(scales[i].name, "",[=]() {
-					mod->onAudioThread([=]() { 
-						node->generateSequencesToDepth(scales[i], 8);
-						mod->pushHistory();
-						renderStateDirty();
-					});
+					mod->generateSequenceAsync(node, scales[i]);
 				}));
 			}
 		}));
 		
 	}
 
-	Node* findNodeClicked(Vec mp, Node* node) {
-		if (!node) return nullptr;
-
-		if (isInsideBox(mp, node->box)) return node;
-
-		for (size_t i = 0; i < node->children.size(); i++)
-		{
-			Node* found = findNodeClicked(mp, node->children[i]);
-			if (found) return found;
+	NodeId findNodeClicked(Vec mp) {
+		NodeTree* tree = frameTree;
+		if (!tree) return NO_NODE;
+		std::vector<NodeId> found;
+		nodeIndex.query(Rect(mp.minus(Vec(xOffset, yOffset)), Vec(0, 0)), found);
+		for (size_t i = 0; i < found.size(); i++) {
+			NodeId node = found[i];
+			if (nodeCache[node].scale * screenScale < 0.01) continue; // not drawn
+			if (!tree->isValid(node)) continue;
+			Rect box = getNodeRect(node);
+			if (isInsideBox(mp, Rect(box.pos.plus(Vec(xOffset, yOffset)), box.size))) return node;
 		}
 
-		return nullptr;
+		return NO_NODE;
 	}
 
 	void onButton(const event::Button &e) override {
@@ -1028,9 +1728,9 @@ struct NodeDisplay : Widget {
 			Vec mousePos = e.pos / screenScale;
 
 			if (e.button == GLFW_MOUSE_BUTTON_LEFT) {
-				Node* foundNode = findNodeClicked(mousePos, &module->rootNode);
+				NodeId foundNode = findNodeClicked(mousePos);
 
-				if (foundNode) {
+				if (foundNode != NO_NODE) {
 					createContextMenuForNode(foundNode);
 				}
 			}
@@ -1111,34 +1811,21 @@ struct NodeDisplay : Widget {
 		nvgRGB(68,187,153)
 	};
 
-	void drawNode(NVGcontext* vg, Node* node, float x, float y,  float scale) {
-		
-		float xVal = x + xOffset;
-		float yVal = y + yOffset;
-		float xSize = NODE_SIZE * scale;
-		float ySize = NODE_SIZE * scale;
-
-		int octOffset = (node->output+1) / 12;
+	void drawNode(NVGcontext* vg, NodeTree* tree, NodeId node, bool dimmed, bool active) {
 
-		bool inSequence = std::find(module->activeSequence.begin(), module->activeSequence.end(), node) != module->activeSequence.end();
+		int output = tree->output[node];
 
-		if (module->params[Treequencer::TRIGGER_TYPE].getValue() && !inSequence) {
-			nvgGlobalAlpha(vg, 0.1);
-		}
+		if (dimmed) nvgGlobalAlpha(vg, 0.1);
 
 		// node bg
-		nvgFillColor(vg, node->enabled ? activeColor[module->colorMode] : octColors[module->colorMode][abs(octOffset%5)]);
+		nvgFillColor(vg, active ? activeColor[module->colorMode] : octColors[module->colorMode][getColorIndex(tree, node)]);
 		nvgBeginPath(vg);
 		nvgRect(vg, 0, 0, NODE_SIZE, NODE_SIZE);
 		nvgFill(vg);
 
-		// update pos for buttonclicking
-		node->box.pos = Vec(xVal, yVal);
-		node->box.size = Vec(xSize, ySize);
-
 		// grid
 		if (module->noteRepresentation == NoteRep::SQUARES) {
-			for (int i = 0; i < abs((node->output+1) % 12); i++) {
+			for (int i = 0; i < abs((output+1) % 12); i++) {
 
 				float boxX = 3 + (3.57 * (i%3));
 				float boxY = 3 + (3.57 * floor(i/3));
@@ -1159,13 +1846,13 @@ struct NodeDisplay : Widget {
 			nvgFontSize(vg, 50);
 			nvgFillColor(vg, nvgRGB(44,44,44));
 			nvgTextAlign(vg, NVGalign::NVG_ALIGN_LEFT);
-			if (module->noteRepresentation == NoteRep::LETTERS) nvgText(vg, 3, 3, Scale::getNoteString(node->output, true).c_str(), NULL);
-			else nvgText(vg, 0, 0, ((std::signbit(node->output+1) ? std::string("-") : (node->output+1 > 9 ? std::string("") : std::string("0"))) + std::to_string(abs(node->output+1))).c_str(), NULL);
+			if (module->noteRepresentation == NoteRep::LETTERS) nvgText(vg, 3, 3, Scale::getNoteString(output, true).c_str(), NULL);
+			else nvgText(vg, 0, 0, ((std::signbit(output+1) ? std::string("-") : (output+1 > 9 ? std::string("") : std::string("0"))) + std::to_string(abs(output+1))).c_str(), NULL);
 			nvgRestore(vg);
 		}
 		
-		if (node->children.size() > 1) {
-			float chance = std::min(1.f, std::max(0.f, node->chance - module->getChanceMod()));
+		if (tree->childCount[node] > 1) {
+			float chance = std::min(1.f, std::max(0.f, tree->chance[node] - module->getChanceMod()));
 
 			nvgFillColor(vg, nvgRGB(240,240,240));
 			nvgBeginPath(vg);
@@ -1181,23 +1868,108 @@ struct NodeDisplay : Widget {
 
 	}
 
-	inline float calcNodeScale(int nodeCount) { return (NODE_SIZE/nodeCount) / NODE_SIZE; }
+	// a node shares its column with 2^(depth+1) slots
+	inline float calcNodeScale(int depth) { return std::ldexp(1.f, -(depth+1)); }
 
-	inline float calcNodeYHeight(float scale, int nodePos, int nodeCount) { return NODE_SIZE+(((NODE_SIZE*scale)*nodePos)-(((NODE_SIZE*scale)*nodeCount)/2)); }
+	// offset is how far down its column a node sits, as a fraction of the column
+	inline float calcNodeYHeight(double offset) { return NODE_SIZE*(0.5+offset); }
 
-	void drawNodes(NVGcontext* vg) {
+	// below this many pixels a node is just a colored square
+	const float DETAIL_PIXEL_SIZE = 6.f;
 
-		for (size_t i = 0; i < nodeCache.size(); i++) {
-			if (nodeCache[i].scale * screenScale < 0.01) continue; // cut when too small
-			//if ((nodeCache[i].pos.x + xOffset) * screenScale > box.size.x || nodeCache[i].pos.y * screenScale > box.size.y) continue;
-			//if (nodeCache[i].pos.x + xOffset + (NODE_SIZE*nodeCache[i].scale*screenScale) < 0 || nodeCache[i].pos.y + (NODE_SIZE*nodeCache[i].scale*screenScale) < 0) continue;
+	std::vector<NodeId> visibleNodes;
+	std::vector<NodeId> batchedNodes[5];
 
-			nvgSave(vg);
-			nvgTranslate(vg, nodeCache[i].pos.x + xOffset, nodeCache[i].pos.y + yOffset);
-			nvgScale(vg, nodeCache[i].scale, nodeCache[i].scale);
-			drawNode(vg, nodeCache[i].node, nodeCache[i].pos.x, nodeCache[i].pos.y, nodeCache[i].scale);
-			nvgRestore(vg);
+	void updateVisibleNodes() {
+		// the scissor box in layout space
+		Rect view = Rect(Vec(-xOffset, -yOffset), box.size.div(screenScale));
+		visibleNodes.clear();
+		nodeIndex.query(view, visibleNodes);
+	}
+
+	// everything but the active node and sequence highlight, in sequence mode every node is drawn dimmed
+	void drawStaticNodes(NVGcontext* vg) {
+		NodeTree* tree = frameTree;
+		bool dimmed = module->params[Treequencer::TRIGGER_TYPE].getValue();
+
+		for (int c = 0; c < 5; c++) batchedNodes[c].clear();
+
+		for (size_t i = 0; i < visibleNodes.size(); i++) {
+			NodeId node = visibleNodes[i];
+			if (!tree->isValid(node)) continue; // empty slot or a removed node
+			NodePosCache& cached = nodeCache[node];
+			float pixelSize = NODE_SIZE * cached.scale * screenScale;
+			if (pixelSize < 0.01) continue; // cut when too small
+
+			if (pixelSize < DETAIL_PIXEL_SIZE) {
+				batchedNodes[getColorIndex(tree, node)].push_back(node);
+				continue;
+			}
+
+			drawCachedNode(vg, tree, node, dimmed, false);
 		}
+
+		// small nodes, one path per color
+		nvgGlobalAlpha(vg, dimmed ? 0.1 : 1.0);
+		for (int c = 0; c < 5; c++) {
+			std::vector<NodeId>& batch = batchedNodes[c];
+			if (batch.empty()) continue;
+
+			nvgFillColor(vg, octColors[module->colorMode][c]);
+			nvgBeginPath(vg);
+			for (size_t i = 0; i < batch.size(); i++) {
+				NodePosCache& cached = nodeCache[batch[i]];
+				nvgRect(vg, cached.pos.x + xOffset, cached.pos.y + yOffset, NODE_SIZE * cached.scale, NODE_SIZE * cached.scale);
+			}
+			nvgFill(vg);
+		}
+		nvgGlobalAlpha(vg, 1.0);
+	}
+
+	// the active node and, in sequence mode, the current sequence at full brightness
+	void drawOverlayNodes(NVGcontext* vg) {
+		NodeTree* tree = frameTree;
+		bool sequenceMode = module->params[Treequencer::TRIGGER_TYPE].getValue();
+		NodeId active = module->activeNode;
+
+		for (size_t i = 0; i < visibleNodes.size(); i++) {
+			NodeId node = visibleNodes[i];
+			if (node != active && !(sequenceMode && isInSequence(tree, node))) continue;
+			if (!tree->isValid(node)) continue;
+			NodePosCache& cached = nodeCache[node];
+			float pixelSize = NODE_SIZE * cached.scale * screenScale;
+			if (pixelSize < 0.01) continue;
+
+			if (pixelSize < DETAIL_PIXEL_SIZE) {
+				nvgFillColor(vg, node == active ? activeColor[module->colorMode] : octColors[module->colorMode][getColorIndex(tree, node)]);
+				nvgBeginPath(vg);
+				nvgRect(vg, cached.pos.x + xOffset, cached.pos.y + yOffset, NODE_SIZE * cached.scale, NODE_SIZE * cached.scale);
+				nvgFill(vg);
+			} else drawCachedNode(vg, tree, node, false, node == active);
+		}
+	}
+
+	void drawCachedNode(NVGcontext* vg, NodeTree* tree, NodeId node, bool dimmed, bool active) {
+		NodePosCache& cached = nodeCache[node];
+		nvgSave(vg);
+		nvgTranslate(vg, cached.pos.x + xOffset, cached.pos.y + yOffset);
+		nvgScale(vg, cached.scale, cached.scale);
+		drawNode(vg, tree, node, dimmed, active);
+		nvgRestore(vg);
+	}
+
+	bool isInSequence(NodeTree* tree, NodeId node) {
+		uint32_t generation = module->sequenceGeneration.load(std::memory_order_acquire);
+		return tree->sequenceStamp[node].value.load(std::memory_order_relaxed) == generation;
+	}
+
+	// index into octColors
+	int getColorIndex(NodeTree* tree, NodeId node) {
+		return abs(((tree->output[node]+1) / 12) % 5);
+	}
+
+	Rect getNodeRect(NodeId node) {
+		return Rect(nodeCache[node].pos, Vec(NODE_SIZE, NODE_SIZE).mult(nodeCache[node].scale));
 	}
 
 	void draw(const DrawArgs &args) override {
@@ -1211,37 +1983,48 @@ struct NodeDisplay : Widget {
 	}
 
 	void drawLayer(const DrawArgs &args, int layer) override {
-		if (module == NULL) return;
+		if (module == NULL || !frameTree) return;
 
 		nvgSave(args.vg);
 		nvgScissor(args.vg, 0, 0, box.size.x, box.size.y);
 
 		//screenScale = 1 - (xOffset / NODE_SIZE);
 
-		nvgScale(args.vg, screenScale, screenScale);
-
 		if (layer == 1) {
 
-			if (isRenderStateDirty()) {
-				int depth = module->rootNode.maxDepth();
-				
-				// Initialize bins
-				nodeBins.clear();
-				int amnt = 1;
-				for (int i = 0; i < depth+1; i++) {
-					nodeBins.push_back(std::vector<Node*>());
-
-					// allocate a full array with nullptrs to help with visuals later
-					amnt *= 2;
-					nodeBins[i].resize(amnt);
-				}
-
-				cacheNodePositions();
+			bool treeChanged = false;
+			if (isRenderStateDirty() || !laidOut || frameTree->version != laidOutVersion) {
+				updateLayout();
 				renderStateClean();
+				treeChanged = true;
 			}
-			drawNodes(args.vg);
 
-			if (module && module->followNodes && (!lastActive || lastActive != module->activeNode)) {
+			StaticState state;
+			state.xOffset = xOffset;
+			state.yOffset = yOffset;
+			state.screenScale = screenScale;
+			state.colorMode = module->colorMode;
+			state.noteRepresentation = module->noteRepresentation;
+			state.sequenceMode = module->params[Treequencer::TRIGGER_TYPE].getValue();
+			// chance bars follow cv and redraw the whole tree, under load the governor spaces those redraws out
+			if (++chanceRefresh >= (1 << module->qualityTier)) {
+				chanceRefresh = 0;
+				shownChanceMod = std::round(module->getChanceMod() * 200); // only redraw for visible changes to the chance bars
+			}
+			state.chanceMod = shownChanceMod;
+
+			if (treeChanged || state != staticState) {
+				staticState = state;
+				updateVisibleNodes();
+				staticFramebuffer->setDirty();
+			}
+
+			Widget::drawChild(staticFramebuffer, args);
+
+			nvgScale(args.vg, screenScale, screenScale);
+			drawOverlayNodes(args.vg);
+
+			if (module && module->followNodes && lastActive != module->activeNode && nodeCache.size()) {
 				NodePosCache activeNode = getActiveCached();
 				xOffset = -(activeNode.pos.x - (0.5*activeNode.scale));
 				yOffset = -(activeNode.pos.y - (0.5*activeNode.scale));
@@ -1255,57 +2038,94 @@ struct NodeDisplay : Widget {
 
 	}
 
-	std::vector<std::vector<Node*>> nodeBins;
 	struct NodePosCache {
 		Vec pos;
 		float scale;
-		Node* node;
-
-		bool operator==(const Node* other) {
-			return node == other;
-		}
+		NodeId node; // NO_NODE for unused slots
 	};
 	
+	// indexed by NodeId
 	std::vector<NodePosCache> nodeCache;
+	NodeQuadTree nodeIndex = NodeQuadTree(Rect());
+	bool laidOut = false;
+	uint64_t laidOutVersion = 0;
 
-	void cacheNodePositions() {
-		
-		gatherNodesForBins(&module->rootNode);
-		nodeCache.clear();
-		
-		float cumulativeX = -25.f;
-		for (size_t d = 0; d < nodeBins.size(); d++) {
-			int binLen = nodeBins[d].size();
-			float scale = calcNodeScale(binLen);
-			float prevScale = calcNodeScale(nodeBins[std::max(0, (int)d-1)].size());
-			cumulativeX += ((NODE_SIZE+1)*prevScale);
-			for(int i = 0; i < binLen; i++) {
-				Node* node = nodeBins[d][i];
-				float y = calcNodeYHeight(scale, i, binLen);
-
-				if (node) {
-					nodeCache.push_back(NodePosCache{Vec(cumulativeX, y), calcNodeScale(binLen), node});
-				}
-				
+	// A node's position only depends on its depth and the child slots leading to it,
+	// so only the subtrees an edit touched need to be laid out again.
+	void updateLayout() {
+		NodeTree* tree = frameTree;
+		bool full = !laidOut || dirtyRender;
+		std::vector<NodeId> changed;
+
+		{
+			std::lock_guard<std::mutex> guard(module->editMutex);
+			std::vector<std::pair<uint64_t, NodeId>>& changes = module->layoutChanges;
+			size_t consumed = 0;
+			// anything newer belongs to a tree process() hasn't picked up yet
+			for (; consumed < changes.size() && changes[consumed].first <= tree->version; consumed++) {
+				if (laidOut && changes[consumed].first <= laidOutVersion) continue;
+				if (changes[consumed].second == NO_NODE) full = true;
+				else changed.push_back(changes[consumed].second);
+			}
+			changes.erase(changes.begin(), changes.begin() + consumed);
+		}
+
+		nodeCache.resize(tree->output.size(), NodePosCache{Vec(), 0.f, NO_NODE});
+
+		if (full) {
+			for (size_t i = 0; i < nodeCache.size(); i++) nodeCache[i].node = NO_NODE;
+			layoutSubtree(tree, tree->root, 0.0);
+		} else {
+			for (size_t i = 0; i < changed.size(); i++) {
+				if (tree->isValid(changed[i])) layoutSubtree(tree, changed[i], getOffset(tree, changed[i]));
 			}
 		}
 
+		buildNodeIndex(tree);
+
+		laidOut = true;
+		laidOutVersion = tree->version;
 	}
 
-	// find the current active node cache data
-	NodePosCache getActiveCached() {
-		return *std::find(nodeCache.begin(), nodeCache.end(), module->activeNode);
+	void buildNodeIndex(NodeTree* tree) {
+		// the root's column spans the full height of every column after it
+		Rect bounds = getNodeRect(tree->root);
+		bounds.size.x = getDepthX(MAX_NODE_DEPTH+1) - bounds.pos.x;
+		nodeIndex.clear(bounds);
+		for (size_t i = 0; i < nodeCache.size(); i++) {
+			if (tree->isValid(nodeCache[i].node)) nodeIndex.insert(getNodeRect(i), i);
+		}
 	}
 
-	void gatherNodesForBins(Node* node, int position = 0, int depth = 0) {
-		nodeBins[depth][position] = node;
+	// where a node sits among the 2^(depth+1) slots of its column, as a fraction so deep trees can't overflow it
+	double getOffset(NodeTree* tree, NodeId node) {
+		std::vector<int> path = tree->getPath(node);
+		double offset = 0.0;
+		for (size_t i = 0; i < path.size(); i++) offset += std::ldexp((double)path[i], -(int)(i+2));
+		return offset;
+	}
+
+	float getDepthX(int depth) {
+		float cumulativeX = -25.f;
+		// columns past 64 are narrower than a float can still add
+		for (int d = 0; d <= std::min(depth, 64); d++) cumulativeX += ((NODE_SIZE+1)*calcNodeScale(std::max(0, d-1)));
+		return cumulativeX;
+	}
 
-		//nodeBins[depth].push_back(&node);
+	void layoutSubtree(NodeTree* tree, NodeId node, double offset) {
+		float scale = calcNodeScale(tree->depth[node]);
+		nodeCache[node] = NodePosCache{Vec(getDepthX(tree->depth[node]), calcNodeYHeight(offset)), scale, node};
 
-		for (size_t i = 0; i < node->children.size(); i++) {
-			gatherNodesForBins(node->children[i], (position*2)+i, depth+1);
+		for (int i = 0; i < tree->childCount[node]; i++) {
+			layoutSubtree(tree, tree->children[node][i], offset + std::ldexp((double)i, -(tree->depth[node]+2)));
 		}
+	}
 
+	// find the current active node cache data
+	NodePosCache getActiveCached() {
+		NodeId active = module->activeNode;
+		if (active < nodeCache.size() && nodeCache[active].node == active) return nodeCache[active];
+		return nodeCache[frameTree->root];
 	}
 
 };
@@ -1448,6 +2268,10 @@ struct TreequencerWidget : QuestionableWidget {
 			mod->followNodes = !mod->followNodes;
 		}));
 
+		menu->addChild(createMenuItem("Pre-roll Sequences", mod->prerollSequences ? "On" : "Off", [=]() {
+			mod->onAudioThread(TreeCommand::SET_PREROLL, NO_NODE, !mod->prerollSequences);
+		}));
+
 		menu->addChild(rack::createSubmenuItem("Default Scale", mod->defaultScale, [=](ui::Menu* menu) {
 			std::vector<Scale> scales = getScalesSorted();
 			for (size_t i = 0; i < scales.size(); i++) {
@@ -1459,44 +2283,50 @@ struct TreequencerWidget : QuestionableWidget {
 
 		menu->addChild(rack::createSubmenuItem("Screen Color Mode", "", [=](ui::Menu* menu) {
 			menu->addChild(createMenuItem("Light", mod->colorMode == ScreenMode::LIGHT ? "•" : "",[=]() {
-				mod->onAudioThread([=]() { mod->colorMode = ScreenMode::LIGHT; });
+				mod->colorMode = ScreenMode::LIGHT;
 				userSettings.setSetting<int>("treequencerScreenColor", ScreenMode::LIGHT);
 			}));
 			menu->addChild(createMenuItem("Vibrant", mod->colorMode == ScreenMode::VIBRANT ? "•" : "", [=]() {
-				mod->onAudioThread([=]() { mod->colorMode = ScreenMode::VIBRANT; });
+				mod->colorMode = ScreenMode::VIBRANT;
 				userSettings.setSetting<int>("treequencerScreenColor", ScreenMode::VIBRANT);
 			}));
 			menu->addChild(createMenuItem("Muted", mod->colorMode == ScreenMode::MUTED ? "•" : "", [=]() {
-				mod->onAudioThread([=]() { mod->colorMode = ScreenMode::MUTED; });
+				mod->colorMode = ScreenMode::MUTED;
 				userSettings.setSetting<int>("treequencerScreenColor", ScreenMode::MUTED);
 			}));
 			menu->addChild(createMenuItem("Greyscale", mod->colorMode == ScreenMode::GREYSCALE ? "•" : "", [=]() {
-				mod->onAudioThread([=]() { mod->colorMode = ScreenMode::GREYSCALE; });
+				mod->colorMode = ScreenMode::GREYSCALE;
 				userSettings.setSetting<int>("treequencerScreenColor", ScreenMode::GREYSCALE);
 			}));
 		}));
 
+		menu->addChild(rack::createSubmenuItem("Undo History Size", "", [=](ui::Menu* menu) {
+			std::vector<std::pair<std::string, int>> limits = {{"Small", 10000}, {"Medium", 100000}, {"Large", 1000000}};
+			for (size_t i = 0; i < limits.size(); i++) {
+				menu->addChild(createMenuItem(limits[i].first, mod->historyLimit == (size_t)limits[i].second ? "•" : "", [=]() {
+					std::lock_guard<std::mutex> guard(mod->editMutex);
+					mod->historyLimit = limits[i].second;
+					mod->trimHistory();
+					userSettings.setSetting<int>("treequencerHistoryLimit", limits[i].second);
+				}));
+			}
+		}));
+
 		menu->addChild(rack::createSubmenuItem("Note Representation", "", [=](ui::Menu* menu) {
 			menu->addChild(createMenuItem("Squares", mod->noteRepresentation == NodeDisplay::SQUARES ? "•" : "", [=]() {
-				mod->onAudioThread([=]() { 
-					mod->noteRepresentation = NodeDisplay::NoteRep::SQUARES; 
-					setText();
-					setWidgetTheme(mod->theme, false); // fix text color
-				});
+				mod->noteRepresentation = NodeDisplay::NoteRep::SQUARES;
+				setText();
+				setWidgetTheme(mod->theme, false); // fix text color
 			}));
 			menu->addChild(createMenuItem("Letters", mod->noteRepresentation == NodeDisplay::LETTERS ? "•" : "",[=]() {
-				mod->onAudioThread([=]() { 
-					mod->noteRepresentation = NodeDisplay::NoteRep::LETTERS; 
-					setText();
-					setWidgetTheme(mod->theme, false); // fix text color
-				});
+				mod->noteRepresentation = NodeDisplay::NoteRep::LETTERS;
+				setText();
+				setWidgetTheme(mod->theme, false); // fix text color
 			}));
 			menu->addChild(createMenuItem("Numbers", mod->noteRepresentation == NodeDisplay::NUMBERS ? "•" : "",[=]() {
-				mod->onAudioThread([=]() { 
-					mod->noteRepresentation = NodeDisplay::NoteRep::NUMBERS; 
-					setText();
-					setWidgetTheme(mod->theme, false); // fix text color
-				});
+				mod->noteRepresentation = NodeDisplay::NoteRep::NUMBERS;
+				setText();
+				setWidgetTheme(mod->theme, false); // fix text color
 			}));
 		}));
 
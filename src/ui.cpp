@@ -1,26 +1,5 @@
 #include "plugin.hpp"
-
-typedef std::function<void(std::string)> textLambda;
-
-struct QuestionableTextField : ui::TextField {
-
-	textLambda functionPtr;
-
-	QuestionableTextField(textLambda fn, int xsize = 100, std::string defaultText = "") : TextField() {
-
-		functionPtr = fn;
-		box.size.x = xsize;
-		text = defaultText;
-
-	}
-
-	void onSelectKey(const SelectKeyEvent& e) override {
-		TextField::onSelectKey(e);
-		functionPtr(text);
-		e.consume(this);
-	}
-
-};
+#include "ui.hpp"
 
 typedef std::function<float()> quantityGetFunc;
 typedef std::function<void(float)> quantitySetFunc;
@@ -0,0 +1,46 @@
+#pragma once
+#include "plugin.hpp"
+
+typedef std::function<void(std::string)> textLambda;
+
+struct QuestionableTextField : ui::TextField {
+
+	textLambda functionPtr;
+	// only hand the text over on enter or when the field goes away instead of on every keystroke
+	bool commitOnly = false;
+	std::string committed;
+
+	QuestionableTextField(textLambda fn, int xsize = 100, std::string defaultText = "", bool commitOnly = false) : TextField() {
+
+		functionPtr = fn;
+		box.size.x = xsize;
+		text = defaultText;
+		committed = defaultText;
+		this->commitOnly = commitOnly;
+
+	}
+
+	void commit() {
+		if (!commitOnly || text == committed) return;
+		committed = text;
+		functionPtr(text);
+	}
+
+	void onSelectKey(const SelectKeyEvent& e) override {
+		TextField::onSelectKey(e);
+		if (!commitOnly) functionPtr(text);
+		e.consume(this);
+	}
+
+	void onAction(const ActionEvent& e) override {
+		commit();
+		TextField::onAction(e);
+	}
+
+	// also sent when the menu closes
+	void onDeselect(const DeselectEvent& e) override {
+		commit();
+		TextField::onDeselect(e);
+	}
+
+};